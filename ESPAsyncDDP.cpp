@@ -20,9 +20,9 @@
 #include <string.h>
 
 // Constructor
-ESPAsyncDDP::ESPAsyncDDP(uint8_t buffers) {
-  pbuff = RingBuf_new(sizeof(DDP_packet_t), buffers);  
+ESPAsyncDDP::ESPAsyncDDP(PacketRing &ring, uint8_t tag) : ring(ring), tag(tag) {
   lastSequenceSeen = 0;
+  dataHandler = nullptr;
 
   stats.packetsReceived = 0;
   stats.bytesReceived = 0;
@@ -68,8 +68,21 @@ bool ESPAsyncDDP::initUDP(IPAddress ourIP) {
 void ESPAsyncDDP::parsePacket(AsyncUDPPacket _packet) {
 
   sbuff = reinterpret_cast<DDP_packet_t *>(_packet.data());
-    
-  pbuff->add(pbuff, sbuff);
+
+  if (dataHandler) {
+    // Payload straight from the packet, trimmed to what actually arrived
+    size_t size = _packet.length();
+    bool tc = sbuff->header.flags & DDP_TIMECODE_FLAG;
+    size_t header = tc ? DDP_TIMECODE_HEADER_SIZE : DDP_HEADER_SIZE;
+    if (size < header)
+      return;
+
+    uint16_t len = std::min<size_t>(htons(sbuff->header.dataLen), size - header);
+    dataHandler(htonl(sbuff->header.channelOffset), sbuff->raw + header, len,
+        sbuff->header.flags & DDP_PUSH_FLAG);
+  } else {
+    ring.push(tag, sbuff, std::min<size_t>(_packet.length(), sizeof(DDP_packet_t)));
+  }
 
   stats.packetsReceived++;
   stats.bytesReceived += _packet.length();
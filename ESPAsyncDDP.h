@@ -33,7 +33,7 @@
 #include <lwip/ip_addr.h>
 #include <lwip/igmp.h>
 #include <Arduino.h>
-#include "RingBuf.h"
+#include "PacketRing.h"
 
 #if LWIP_VERSION_MAJOR == 1
 typedef struct ip_addr ip4_addr_t;
@@ -71,6 +71,13 @@ typedef union __attribute__((packed)) {
   uint8_t raw[1458];
 } DDP_packet_t;
 
+#define DDP_HEADER_SIZE (sizeof(DDP_Header) - 1)
+#define DDP_TIMECODE_HEADER_SIZE (sizeof(DDP_TimeCode_Header) - 1)
+
+// Payload handler, called from the UDP callback with the data still in the packet
+typedef void (*DDP_data_handler_t)(uint32_t offset, const uint8_t *data,
+        uint16_t len, bool push);
+
 typedef struct __attribute__((packed)) {
   uint32_t packetsReceived;
   uint32_t bytesReceived;
@@ -84,8 +91,10 @@ class ESPAsyncDDP {
 
     DDP_packet_t   *sbuff;       // Pointer to scratch packet buffer
     AsyncUDP        udp;         // UDP
-    RingBuf         *pbuff;      // Ring Buffer of universe packet buffers
+    PacketRing      &ring;       // Queue shared with the other receivers
+    uint8_t         tag;         // Our records in ring
     uint8_t         lastSequenceSeen;
+    DDP_data_handler_t dataHandler;  // Takes payloads in place of the ring
   
     // Internal Initializers
     bool initUDP(IPAddress ourIP);
@@ -96,14 +105,14 @@ class ESPAsyncDDP {
  public:
     DDP_stats_t  stats;    // Statistics tracker
 
-    ESPAsyncDDP(uint8_t buffers = 1);
+    // Packets are queued in ring under tag unless a data handler takes them
+    ESPAsyncDDP(PacketRing &ring, uint8_t tag);
 
     // Generic UDP listener, no physical or IP configuration
     bool begin(IPAddress ourIP);
 
-    // Ring buffer access
-    inline bool isEmpty() { return pbuff->isEmpty(pbuff); }
-    inline void *pull(DDP_packet_t *packet) { return pbuff->pull(pbuff, packet); }
+    // Hand payloads to handler as they arrive instead of queueing packets
+    inline void onData(DDP_data_handler_t handler) { dataHandler = handler; }
 };
 
 
@@ -17,12 +17,13 @@
 */
 
 #include "ESPAsyncZCPP.h"
+#include "LogSink.h"
 #include <string.h>
 
 // Constructor
-ESPAsyncZCPP::ESPAsyncZCPP(uint8_t buffers) {
-    pbuff = RingBuf_new(sizeof(ZCPP_packet_t), buffers);
+ESPAsyncZCPP::ESPAsyncZCPP(PacketRing &ring, uint8_t tag) : ring(ring), tag(tag) {
 	suspend = false;
+    dataHandler = nullptr;
 	
     stats.num_packets = 0;
     stats.packet_errors = 0;
@@ -63,10 +64,8 @@ bool ESPAsyncZCPP::initUDP(IPAddress ourIP) {
   	ifaddr.addr = static_cast<uint32_t>(ourIP);
 	  multicast_addr.addr = static_cast<uint32_t>(IPAddress(224, 0, 31, (ifaddr.addr & 0xFF000000) >> 24));
 	  igmp_joingroup(&ifaddr, &multicast_addr);
-    if (Serial) {
-        Serial.print("ZCPP subscribed to multicast 224.0.31.");
-        Serial.println((ifaddr.addr & 0xFF000000) >> 24);
-    }
+    logSink.print("ZCPP subscribed to multicast 224.0.31.");
+    logSink.println((ifaddr.addr & 0xFF000000) >> 24);
     return success;
 }
 
@@ -108,8 +107,18 @@ void ESPAsyncZCPP::parsePacket(AsyncUDPPacket _packet) {
 		    (sbuff->Discovery.Header.type == ZCPP_TYPE_CONFIG && (sbuff->Configuration.flags & ZCPP_CONFIG_FLAG_QUERY_CONFIGURATION_RESPONSE_REQUIRED) != 0)) {
 			suspend = true;
 		}
-		
-        pbuff->add(pbuff, sbuff);
+
+        if (dataHandler && sbuff->Discovery.Header.type == ZCPP_TYPE_DATA) {
+            // Payload straight from the packet, trimmed to what actually arrived
+            size_t size = _packet.length();
+            if (size < ZCPP_DATA_HEADER_SIZE)
+                return;
+            uint16_t len = std::min<size_t>(ntohs(sbuff->Data.packetDataLength),
+                    size - ZCPP_DATA_HEADER_SIZE);
+            dataHandler(&sbuff->Data, len);
+        } else {
+            ring.push(tag, sbuff, std::min<size_t>(_packet.length(), sizeof(ZCPP_packet_t)));
+        }
         stats.num_packets++;
         stats.last_clientIP = _packet.remoteIP();
         stats.last_clientPort = _packet.remotePort();
@@ -117,8 +126,7 @@ void ESPAsyncZCPP::parsePacket(AsyncUDPPacket _packet) {
     } else if (error == ERROR_ZCPP_IGNORE || suspend) {
         // Do nothing
     } else {
-        if (Serial)
-            dumpError(error);
+        dumpError(error);
         stats.packet_errors++;
     }
 }
@@ -132,14 +140,14 @@ void ESPAsyncZCPP::parsePacket(AsyncUDPPacket _packet) {
 void ESPAsyncZCPP::dumpError(ZCPP_error_t error) {
     switch (error) {
         case ERROR_ZCPP_ID:
-            Serial.print(F("INVALID PACKET ID: "));
+            logSink.print(F("INVALID PACKET ID: "));
             for (uint i = 0; i < sizeof(ZCPP_token); i++)
-                Serial.print(sbuff->Discovery.Header.token[i], HEX);
-            Serial.println("");
+                logSink.print(sbuff->Discovery.Header.token[i], HEX);
+            logSink.println("");
             break;
         case ERROR_ZCPP_PROTOCOL_VERSION:
-            Serial.print(F("INVALID PROTOCOL VERSION: 0x"));
-            Serial.println(sbuff->Discovery.Header.protocolVersion, HEX);
+            logSink.print(F("INVALID PROTOCOL VERSION: 0x"));
+            logSink.println(sbuff->Discovery.Header.protocolVersion, HEX);
             break;
         case ERROR_ZCPP_NONE:
             break;
@@ -151,15 +159,12 @@ void ESPAsyncZCPP::dumpError(ZCPP_error_t error) {
 void ESPAsyncZCPP::sendConfigResponse(ZCPP_packet_t* packet)
 {
   if (udp.writeTo(packet->raw, sizeof(ZCPP_packet_t), stats.last_clientIP, stats.last_clientPort) != sizeof(ZCPP_packet_t)) {
-    if (Serial)
-        Serial.println("Write of configuration response failed");
+    logSink.println("Write of configuration response failed");
   }
   else {
-    if (Serial) {
-        Serial.print("Configuration response wrote ");
-        Serial.print(sizeof(ZCPP_packet_t));
-        Serial.println(" bytes.");
-    }
+    logSink.print("Configuration response wrote ");
+    logSink.print(sizeof(ZCPP_packet_t));
+    logSink.println(" bytes.");
   }
   suspend = false;
 }
@@ -188,24 +193,28 @@ void ESPAsyncZCPP::sendDiscoveryResponse(ZCPP_packet_t* packet, const char* firm
 	if (pixelPorts > 0) {
 		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_WS2811;
 		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_GECE;
+		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_SK6812;
+		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_APA102;
+		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_WS2801;
+		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_LPD8806;
 	}
 	if (serialPorts > 0) {
 		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_DMX;
 		protocolsSupported |= ZCPP_DISCOVERY_PROTOCOL_RENARD;
 	}
 	packet->DiscoveryResponse.protocolsSupported = ntohl(protocolsSupported);
-	packet->DiscoveryResponse.flags = ZCPP_DISCOVERY_FLAG_SEND_DATA_AS_MULTICAST;
+	uint16_t flags = ZCPP_DISCOVERY_FLAG_SEND_DATA_AS_MULTICAST;
+	if (pixelPorts > 0)
+		flags |= ZCPP_DISCOVERY_FLAG_SUPPORTS_VIRTUAL_STRINGS;
+	packet->DiscoveryResponse.flags = ntohs(flags);
 
 	if (udp.writeTo(packet->raw, sizeof(packet->DiscoveryResponse), stats.last_clientIP, stats.last_clientPort) != sizeof(packet->DiscoveryResponse)) {
-    if (Serial)
-    		Serial.println("Write of discovery response failed");
+		logSink.println("Write of discovery response failed");
 	}
 	else {
-    if (Serial) {
-  		Serial.print("Discovery response wrote ");
-  		Serial.print(sizeof(packet->DiscoveryResponse));
-  		Serial.println(" bytes.");
-    }
+		logSink.print("Discovery response wrote ");
+		logSink.print(sizeof(packet->DiscoveryResponse));
+		logSink.println(" bytes.");
 	}
 	suspend = false;
 }
@@ -33,7 +33,7 @@
 #include <lwip/ip_addr.h>
 #include <lwip/igmp.h>
 #include <Arduino.h>
-#include "RingBuf.h"
+#include "PacketRing.h"
 
 #if LWIP_VERSION_MAJOR == 1
 typedef struct ip_addr ip4_addr_t;
@@ -49,6 +49,9 @@ typedef enum {
     ERROR_ZCPP_PROTOCOL_VERSION,
 } ZCPP_error_t;
 
+// Data packet handler, called from the UDP callback with len checked against the packet
+typedef void (*ZCPP_data_handler_t)(const ZCPP_Data *data, uint16_t len);
+
 // Status structure
 typedef struct {
     uint32_t    num_packets;
@@ -63,8 +66,10 @@ class ESPAsyncZCPP {
 
 	ZCPP_packet_t   *sbuff;       // Pointer to scratch packet buffer
     AsyncUDP        udp;          // UDP
-    RingBuf         *pbuff;       // Ring Buffer of universe packet buffers
+    PacketRing      &ring;        // Queue shared with the other receivers
+    uint8_t         tag;          // Our records in ring
 	bool            suspend;      // suspends all ZCPP processing until discovery is responded to
+    ZCPP_data_handler_t dataHandler;  // Takes data packets in place of the ring
 	
     // Internal Initializers
     bool initUDP(IPAddress ourIP);
@@ -75,14 +80,14 @@ class ESPAsyncZCPP {
  public:
     ZCPP_stats_t  stats;    // Statistics tracker
 
-    ESPAsyncZCPP(uint8_t buffers = 1);
+    // Packets are queued in ring under tag, data ones unless a handler takes them
+    ESPAsyncZCPP(PacketRing &ring, uint8_t tag);
 
     // Generic UDP listener, no physical or IP configuration
     bool begin(IPAddress ourIP);
 
-    // Ring buffer access
-    inline bool isEmpty() { return pbuff->isEmpty(pbuff); }
-    inline void *pull(ZCPP_packet_t *packet) { return pbuff->pull(pbuff, packet); }
+    // Hand data packets to handler as they arrive, everything else stays queued
+    inline void onData(ZCPP_data_handler_t handler) { dataHandler = handler; }
 	  void sendDiscoveryResponse(ZCPP_packet_t* packet, const char* firmwareVersion, const uint8_t* mac, const char* controllerName, int pixelPorts, int serialPorts, uint32_t maxPixelPortChannels, uint32_t maxSerialPortChannels, uint32_t maximumChannels, uint32_t ipAddress, uint32_t ipMask);
     void sendConfigResponse(ZCPP_packet_t* packet);
 
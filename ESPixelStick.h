@@ -42,6 +42,7 @@ const char BUILD_DATE[] = __DATE__;
 #endif
 
 #include "EffectEngine.h"
+#include "LogSink.h"
 
 #define HTTP_PORT       80      /* Default web server port */
 #define MQTT_PORT       1883    /* Default MQTT port */
@@ -50,10 +51,15 @@ const char BUILD_DATE[] = __DATE__;
 #define PIXEL_LIMIT     1360    /* Total pixel limit - 40.85ms for 8 universes */
 #define RENARD_LIMIT    2048    /* Channel limit for serial outputs */
 #define E131_TIMEOUT    1000    /* Force refresh every second an E1.31 packet is not seen */
+#define FULL_REFRESH    1000    /* Resend unchanged outputs in full every second */
 #define CLIENT_TIMEOUT  15      /* In station/client mode try to connection for 15 seconds */
 #define AP_TIMEOUT      60      /* In AP mode, wait 60 seconds for a connection or reboot */
 #define REBOOT_DELAY    100     /* Delay for rebooting once reboot flag is set */
-#define LOG_PORT        Serial  /* Serial port for console logging */
+#define PACKET_RING_SIZE 2944   /* Bytes of ZCPP control packets queued for loop(), see below */
+#define FRAME_TIMEOUT   50      /* Max ms to wait for the rest of a DDP / ZCPP frame */
+#define SEQ_WINDOW      20      /* E1.31 packets 1 to this many behind the next expected are out of order */
+#define SEQ_UNSEEN      0x100   /* Sequence tracker of a universe with no packets yet */
+#define LOG_PORT        logSink /* Deferred console log, drained to Serial */
 
 // E1.33 / RDMnet stuff - to be moved to library
 #define RDMNET_DNSSD_SRV_TYPE   "draft-e133.tcp"
@@ -85,6 +91,25 @@ enum class DataSource : uint8_t {
     DDP
 };
 
+/*
+* Receiver tags in the packet ring. DDP and ZCPP data go to their callbacks
+* and E1.31 keeps its own queue, so only ZCPP discovery / config / query /
+* sync packets are queued. A ZCPP record is at most 1464 bytes (1458 + the
+* header, padded), PACKET_RING_SIZE is just over two so one always fits an
+* empty ring wherever it's at.
+*/
+enum RingTag : uint8_t {
+    RING_DDP,
+    RING_ZCPP
+};
+
+// Where the slots of one E1.31 universe land, built by updateConfig()
+typedef struct {
+    uint16_t    src;            /* First slot used, 0 based */
+    uint16_t    dst;            /* Output channel it goes to */
+    uint16_t    len;            /* Slots used */
+} universe_map_t;
+
 // Configuration structure
 typedef struct {
     /* Device */
@@ -113,6 +138,7 @@ typedef struct {
     bool effect_reverse;
     bool effect_mirror;
     bool effect_allleds;
+    bool effect_white;	/* Extract white from r/g/b on RGBW pixels */
     bool effect_startenabled;
     bool effect_idleenabled;
     uint16_t effect_idletimeout;
@@ -135,6 +161,9 @@ typedef struct {
     uint16_t    channel_start;  /* Channel to start listening at - 1 based */
     uint16_t    channel_count;  /* Number of channels */
     bool        multicast;      /* Enable multicast listener */
+    uint16_t    full_refresh;   /* Max ms between full output frames - 0 = every frame */
+    uint8_t     target_fps;     /* Output frame rate cap - 0 = as fast as the output allows */
+    uint16_t    frame_timeout;  /* Max ms to hold a partial DDP / ZCPP frame - 0 = show at its end */
 
 #if defined(ESPS_MODE_PIXEL)
     /* Pixels */
@@ -144,10 +173,39 @@ typedef struct {
     uint16_t    groupSize;      /* Group size - 1 = no grouping */
     float       gammaVal;       /* gamma value to use */
     float       briteVal;       /* brightness lto use */
+    bool        dither;         /* Temporal dithering of the gamma curve */
+    bool        interpolate;    /* Blend streamed frames up to the refresh rate */
+    float       balance[4];     /* R / G / B / W white balance scale */
+    uint16_t    colorTemp;      /* White point in Kelvin - 0 = no correction */
+    uint16_t    power_limit;    /* Supply budget per string in mA - 0 = no limit */
+    uint8_t     channel_ma;     /* mA drawn by a channel at full */
+    uint8_t     seg_count;      /* Virtual strings set by ZCPP - 0 = group / zigzag */
+    pixel_segment_t segments[PIXEL_SEGMENTS];   /* Virtual strings, start from channel_start */
+
+    /* Second WS2811 string on UART0 (GPIO1 / TX), takes over the log port */
+    bool        port2;          /* Enable the second string */
+    PixelColor  port2_color;    /* Second string color order */
+    uint16_t    port2_start;    /* First channel of the second string, 0 based from channel_start */
+    uint16_t    port2_count;    /* Number of channels on the second string */
+    uint16_t    port2_group;    /* Second string group size - 1 = no grouping */
+    uint16_t    port2_zig;      /* Second string zigzag count - 0 = no zigzag */
+    uint8_t     port2_seg_count;    /* Second string virtual strings */
+    pixel_segment_t port2_segments[PIXEL_SEGMENTS]; /* Start from port2_start */
 #elif defined(ESPS_MODE_SERIAL)
     /* Serial */
     SerialType  serial_type;    /* Serial type */
     BaudRate    baudrate;       /* Baudrate */
+    uint16_t    dmx_break;      /* DMX break in us */
+    uint16_t    dmx_mab;        /* DMX mark after break in us */
+
+    /* Second universe on SEROUT2_UART, UART0 takes over the log port */
+    bool        serial2;        /* Enable the second port */
+    uint16_t    serial2_start;  /* First channel of the second port, 0 based from channel_start */
+
+    /* Response curves and fades by channel range, across both ports */
+    uint8_t     profile_count;  /* Number of profiles */
+    serial_profile_t profiles[SERIAL_PROFILES];
+    uint8_t     custom_curve[256];  /* Table for SerialCurve::CUSTOM */
 #endif
 } config_t;
 
@@ -158,6 +216,15 @@ void dsDeviceConfig(const JsonObject &json);
 void dsEffectConfig(const JsonObject &json);
 void saveConfig();
 void dsGammaConfig(const JsonObject &json);
+void dsColorConfig(const JsonObject &pixel);
+#if defined(ESPS_MODE_PIXEL)
+void dsSegments(const JsonArray &json, pixel_segment_t *segments, uint8_t &count);
+void serializeSegments(JsonArray json, const pixel_segment_t *segments, uint8_t count);
+uint16_t validateSegments(pixel_segment_t *segments, uint8_t &count, uint8_t chPixel);
+#elif defined(ESPS_MODE_SERIAL)
+void dsProfiles(const JsonObject &serial);
+void serializeProfiles(JsonObject serial);
+#endif
 
 void connectWifi();
 void onWifiConnect(const WiFiEventStationModeGotIP &event);
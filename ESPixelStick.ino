@@ -32,6 +32,7 @@ const char passphrase[] = "ENTER_PASSPHRASE_HERE";
 #include <ESPAsyncE131.h>
 #include "ESPAsyncZCPP.h"
 #include "ESPAsyncDDP.h"
+#include "FrameAssembler.h"
 #include <Hash.h>
 #include <SPI.h>
 #include "ESPixelStick.h"
@@ -72,20 +73,33 @@ const char LIGHT_OFF[] = "OFF";
 const char CONFIG_FILE[] = "/config.json";
 
 ESPAsyncE131        e131(10);       // ESPAsyncE131 with X buffers
-ESPAsyncZCPP        zcpp(5);        // ESPAsyncZCPP with X buffers
-ESPAsyncDDP         ddp(5);         // ESPAsyncDDP with X buffers
+PacketRing          packetRing(PACKET_RING_SIZE);   // ZCPP control packets for loop()
+ESPAsyncZCPP        zcpp(packetRing, RING_ZCPP);    // Data goes to zcppData()
+ESPAsyncDDP         ddp(packetRing, RING_DDP);      // Data goes to ddpData()
 FPPDiscovery        fppDiscovery(VERSION);   // FPP Discovery Listener
 
 config_t            config;         // Current configuration
 uint32_t            *seqError;      // Sequence error tracking for each universe
-uint32_t            *seqZCPPError;  // Sequence error tracking for each universe
+uint32_t            seqZCPPError;   // ZCPP sequence errors
+uint32_t            seqZCPPLogged;  // seqZCPPError as of the last log line
+uint8_t             seqZCPPWanted;  // Expected and actual sequence of the last error
+uint8_t             seqZCPPGot;
 uint16_t            lastZCPPConfig; // last config we saw
 uint8_t             seqZCPPTracker; // sequence number of zcpp frames
+FrameAssembler      ddpFrame;       // DDP frame in progress
+FrameAssembler      zcppFrame;      // ZCPP frame in progress
+uint8_t             zcppFrameSeq;   // Sequence number of the ZCPP frame in progress
+bool                zcppSeen;       // ZCPP data arrived since the last loop()
 uint16_t            uniLast = 1;    // Last Universe to listen for
+uint16_t            chanLast;       // Output channels across all ports
 bool                reboot = false; // Reboot flag
 AsyncWebServer      web(HTTP_PORT); // Web Server
 AsyncWebSocket      ws("/ws");      // Web Socket Plugin
-uint8_t             *seqTracker;    // Current sequence numbers for each Universe */
+uint16_t            *seqTracker;    // Next sequence number for each Universe, SEQ_UNSEEN before the first
+uint32_t            seqStale;       // E1.31 packets dropped as out of order
+universe_map_t      *uniMap;        // Output span of each Universe
+uint8_t             *uniStage;      // Latest payload of each Universe, laid out like the outputs
+uint16_t            *uniFill;       // Slots staged for each Universe, 0 if nothing new
 uint32_t            lastUpdate;     // Update timeout tracker
 WiFiEventHandler    wifiConnectHandler;     // WiFi connect handler
 WiFiEventHandler    wifiDisconnectHandler;  // WiFi disconnect handler
@@ -100,8 +114,10 @@ IPAddress           ourSubnetMask;
 // Output Drivers
 #if defined(ESPS_MODE_PIXEL)
 PixelDriver     pixels;         // Pixel object
+PixelDriver     pixels2(0);     // Second string on UART0
 #elif defined(ESPS_MODE_SERIAL)
 SerialDriver    serial;         // Serial object
+SerialDriver    serial2(SEROUT2_UART);  // Second universe
 #else
 #error "No valid output mode defined."
 #endif
@@ -198,7 +214,10 @@ void setup() {
     // set the effect idle timer
     idleTicker.attach(config.effect_idletimeout, idleTimeout);
 
-    pixels.show();
+    // Hand over the first frame, the first service() in loop() sends it
+    pixels.commit(false);
+    if (config.port2)
+        pixels2.commit(false);
 #else
     updateConfig();
     // Do one effects cycle as early as possible
@@ -208,7 +227,10 @@ void setup() {
     // set the effect idle timer
     idleTicker.attach(config.effect_idletimeout, idleTimeout);
 
-    serial.show();
+    // Hand over the first frame, the first service() in loop() sends it
+    serial.commit();
+    if (config.serial2)
+        serial2.commit();
 #endif
 
     // Setup WiFi Handlers
@@ -278,6 +300,7 @@ void setup() {
     }
     fppDiscovery.begin();
 
+    ddp.onData(ddpData);
     if (ddp.begin(ourLocalIP)) {
       LOG_PORT.println(F("- DDP Enabled"));
     } else {
@@ -285,6 +308,7 @@ void setup() {
     }
 
     lastZCPPConfig = -1;
+    zcpp.onData(zcppData);
     if (zcpp.begin(ourLocalIP)) {
         LOG_PORT.println(F("- ZCPP Enabled"));
         ZCPPSub();
@@ -546,7 +570,12 @@ void publishHA(bool join) {
         JsonObject device = root.createNestedObject("device");
         device["identifiers"] = WiFi.macAddress();
         device["manufacturer"] = "ESPixelStick";
-        device["model"] = String(config.channel_count / 3) + " Pixel Controller";
+#if defined(ESPS_MODE_PIXEL)
+        device["model"] = String(config.channel_count / pixelChannels(config.pixel_color))
+                + " Pixel Controller";
+#elif defined(ESPS_MODE_SERIAL)
+        device["model"] = String(config.channel_count) + " Channel Controller";
+#endif
         device["name"] = config.id;
         device["sw_version"] = "ESPixelStick v" + String(VERSION);
 
@@ -699,27 +728,62 @@ void validateConfig() {
     config.devmode.MPIXEL = true;
     config.devmode.MSERIAL = false;
 
-    // Generic channel limits for pixels
-    if (config.channel_count % 3)
-        config.channel_count = (config.channel_count / 3) * 3;
+    // GECE is RGB only
+    if (config.pixel_type == PixelType::GECE)
+        config.pixel_color = PixelColor::RGB;
 
-    if (config.channel_count > PIXEL_LIMIT * 3)
-        config.channel_count = PIXEL_LIMIT * 3;
+    // Clocked pixels have no white channel
+    if (isClocked(config.pixel_type) && pixelChannels(config.pixel_color) == 4)
+        config.pixel_color = PixelColor(static_cast<uint8_t>(config.pixel_color) % 6);
+
+    // Generic channel limits for pixels, virtual strings size the string
+    uint8_t chPixel = pixelChannels(config.pixel_color);
+    if (config.seg_count)
+        config.channel_count = validateSegments(config.segments,
+                config.seg_count, chPixel) * chPixel;
+    if (config.channel_count % chPixel)
+        config.channel_count = (config.channel_count / chPixel) * chPixel;
+
+    if (config.channel_count > PIXEL_LIMIT * chPixel)
+        config.channel_count = PIXEL_LIMIT * chPixel;
     else if (config.channel_count < 1)
         config.channel_count = 1;
 
-    if (config.groupSize > config.channel_count / 3)
-        config.groupSize = config.channel_count / 3;
+    if (config.groupSize > config.channel_count / chPixel)
+        config.groupSize = config.channel_count / chPixel;
     else if (config.groupSize < 1)
         config.groupSize = 1;
 
     // GECE Limits
     if (config.pixel_type == PixelType::GECE) {
-        config.pixel_color = PixelColor::RGB;
-        if (config.channel_count > 63 * 3)
-            config.channel_count = 63 * 3;
+        if (config.channel_count > GECE_BULBS * 3)
+            config.channel_count = GECE_BULBS * 3;
     }
 
+    // A channel that draws nothing would hide the whole load
+    if (!config.channel_ma)
+        config.channel_ma = POWER_CHANNEL_MA;
+
+    // Second string shares the pixel limit with the first
+    uint8_t chPixel2 = pixelChannels(config.port2_color);
+    uint16_t pixels2Max = PIXEL_LIMIT - config.channel_count / chPixel;
+    if (config.port2_seg_count)
+        config.port2_count = validateSegments(config.port2_segments,
+                config.port2_seg_count, chPixel2) * chPixel2;
+    config.port2_count -= config.port2_count % chPixel2;
+    if (config.port2_count > pixels2Max * chPixel2)
+        config.port2_count = pixels2Max * chPixel2;
+    if (!config.port2_count)
+        config.port2 = false;
+
+    if (config.port2_start > PIXEL_LIMIT * 4)
+        config.port2_start = PIXEL_LIMIT * 4;
+
+    if (config.port2_group > config.port2_count / chPixel2)
+        config.port2_group = config.port2_count / chPixel2;
+    if (config.port2_group < 1)
+        config.port2_group = 1;
+
     // Default gamma value
     if (config.gammaVal <= 0) {
         config.gammaVal = 2.2;
@@ -729,6 +793,15 @@ void validateConfig() {
     if (config.briteVal <= 0) {
         config.briteVal = 1.0;
     }
+
+    // Default white balance, unset channels pass through
+    for (uint8_t i = 0; i < GAMMA_CHANNELS; i++) {
+        if (config.balance[i] <= 0 || config.balance[i] > 1.0)
+            config.balance[i] = 1.0;
+    }
+
+    if (config.colorTemp && (config.colorTemp < 2000 || config.colorTemp > 10000))
+        config.colorTemp = 0;
 #elif defined(ESPS_MODE_SERIAL)
     // Set Mode
     config.devmode.MPIXEL = false;
@@ -748,8 +821,38 @@ void validateConfig() {
         config.baudrate = BaudRate::BR_460800;
     else if (config.baudrate < BaudRate::BR_38400)
         config.baudrate = BaudRate::BR_57600;
+
+    // DMX timing, some fixtures want more than the E1.11 minimums
+    config.dmx_break = constrain(config.dmx_break, DMX_BREAK, DMX_TIMING_MAX);
+    config.dmx_mab = constrain(config.dmx_mab, DMX_MAB, DMX_TIMING_MAX);
+
+    // Second port carries the same channel count, by default from the next universe
+    if (config.serial2 && config.serial2_start < config.channel_count)
+        config.serial2_start = (config.channel_count + config.universe_limit - 1)
+                / config.universe_limit * config.universe_limit;
+    if (config.serial2_start > RENARD_LIMIT)
+        config.serial2_start = RENARD_LIMIT;
+
+    // Curves and fades
+    if (config.profile_count > SERIAL_PROFILES)
+        config.profile_count = SERIAL_PROFILES;
+    for (uint8_t i = 0; i < config.profile_count; i++) {
+        if (config.profiles[i].curve > SerialCurve::CUSTOM)
+            config.profiles[i].curve = SerialCurve::LINEAR;
+        if (config.profiles[i].fade > SERIAL_FADE_MAX)
+            config.profiles[i].fade = SERIAL_FADE_MAX;
+    }
+
+    // A custom curve never reaching full is one that was never loaded
+    if (!config.custom_curve[255]) {
+        for (uint16_t i = 0; i < 256; i++)
+            config.custom_curve[i] = i;
+    }
 #endif
 
+    if (config.frame_timeout > 1000)
+        config.frame_timeout = 1000;
+
     if (config.effect_speed < 1)
         config.effect_speed = 1;
     if (config.effect_speed > 10)
@@ -782,8 +885,16 @@ void updateConfig() {
     // Validate first
     validateConfig();
 
-    // Find the last universe we should listen for
-    uint16_t span = config.channel_start + config.channel_count - 1;
+    // Find the last channel and universe we should listen for
+    chanLast = config.channel_count;
+#if defined(ESPS_MODE_PIXEL)
+    if (config.port2 && config.port2_start + config.port2_count > chanLast)
+        chanLast = config.port2_start + config.port2_count;
+#elif defined(ESPS_MODE_SERIAL)
+    if (config.serial2)
+        chanLast = config.serial2_start + config.channel_count;
+#endif
+    uint16_t span = config.channel_start + chanLast - 1;
     if (span % config.universe_limit)
         uniLast = config.universe + span / config.universe_limit;
     else
@@ -793,16 +904,45 @@ void updateConfig() {
     uint8_t uniTotal = (uniLast + 1) - config.universe;
 
     if (seqTracker) free(seqTracker);
-    if ((seqTracker = static_cast<uint8_t *>(malloc(uniTotal))))
-        memset(seqTracker, 0x00, uniTotal);
+    if ((seqTracker = static_cast<uint16_t *>(malloc(uniTotal * sizeof(uint16_t))))) {
+        for (uint8_t i = 0; i < uniTotal; i++)
+            seqTracker[i] = SEQ_UNSEEN;
+    }
+    seqStale = 0;
 
     seqZCPPTracker = 0;
+    ddpFrame.begin(config.frame_timeout, commitFrame);
+    zcppFrame.begin(config.frame_timeout, commitFrame);
 
     if (seqError) free(seqError);
     if ((seqError = static_cast<uint32_t *>(malloc(uniTotal * 4))))
         memset(seqError, 0x00, uniTotal * 4);
 
-    seqZCPPError = 0;
+    seqZCPPError = seqZCPPLogged = 0;
+
+    /*
+    * Universe scatter table. The first universe skips the slots before
+    * channel_start, and each universe stops at the last output channel.
+    */
+    if (uniMap) free(uniMap);
+    if ((uniMap = static_cast<universe_map_t *>(malloc(uniTotal * sizeof(universe_map_t))))) {
+        for (uint8_t i = 0; i < uniTotal; i++) {
+            int32_t start = i * config.universe_limit - (config.channel_start - 1);
+            uniMap[i].src = start < 0 ? -start : 0;
+            uniMap[i].dst = start < 0 ? 0 : start;
+            uniMap[i].len = 0;
+            if (uniMap[i].dst < chanLast)
+                uniMap[i].len = std::min<int32_t>(config.universe_limit - uniMap[i].src,
+                        chanLast - uniMap[i].dst);
+        }
+    }
+
+    // One latest-wins slot per universe, each where its span lands
+    if (uniStage) free(uniStage);
+    uniStage = static_cast<uint8_t *>(malloc(chanLast));
+    if (uniFill) free(uniFill);
+    if ((uniFill = static_cast<uint16_t *>(malloc(uniTotal * sizeof(uint16_t)))))
+        memset(uniFill, 0x00, uniTotal * sizeof(uint16_t));
 
     // Zero out packet stats
     e131.stats.num_packets = 0;
@@ -810,20 +950,66 @@ void updateConfig() {
 
     // Initialize for our pixel type
 #if defined(ESPS_MODE_PIXEL)
-    pixels.begin(config.pixel_type, config.pixel_color, config.channel_count / 3);
+    // UART0 carries either the second string or the log console
+    if (config.port2)
+        logSink.release();
+    else
+        logSink.restore();
+
+    uint8_t chPixel = pixelChannels(config.pixel_color);
+    pixels.begin(config.pixel_type, config.pixel_color, config.channel_count / chPixel);
     pixels.setGroup(config.groupSize, config.zigSize);
-    updateGammaTable(config.gammaVal, config.briteVal);
+    pixels.setSegments(config.segments, config.seg_count);
+    pixels.setDither(config.dither);
+    pixels.setInterpolate(config.interpolate);
+    pixels.setFullRefresh(config.full_refresh);
+    pixels.setTargetFps(config.target_fps);
+    pixels.setPowerLimit(config.power_limit, config.channel_ma);
+    updateGammaTable(config.gammaVal, pixels.setBrightness(config.briteVal),
+            config.balance, config.colorTemp);
     if (config.groupSize == 0) config.groupSize = 1;
-    effects.begin(&pixels, config.channel_count / 3 / config.groupSize);
+    effects.begin(&pixels, config.channel_count / chPixel / config.groupSize, chPixel);
+
+    if (config.port2) {
+        uint8_t chPixel2 = pixelChannels(config.port2_color);
+        pixels2.begin(PixelType::WS2811, config.port2_color, config.port2_count / chPixel2);
+        pixels2.setGroup(config.port2_group, config.port2_zig);
+        pixels2.setSegments(config.port2_segments, config.port2_seg_count);
+        pixels2.setDither(config.dither);
+        pixels2.setInterpolate(config.interpolate);
+        pixels2.setFullRefresh(config.full_refresh);
+        pixels2.setTargetFps(config.target_fps);
+        pixels2.setPowerLimit(config.power_limit, config.channel_ma);
+    }
 
 #elif defined(ESPS_MODE_SERIAL)
+    // UART0 carries either an output or the log console
+    if (SEROUT_UART == 0 || (config.serial2 && SEROUT2_UART == 0))
+        logSink.release();
+    else
+        logSink.restore();
+
+    serial.setBreak(config.dmx_break, config.dmx_mab);
     serial.begin(&SEROUT_PORT, config.serial_type, config.channel_count, config.baudrate);
-    effects.begin(&serial, config.channel_count / 3 );
+    serial.setFullRefresh(config.full_refresh);
+    serial.setTargetFps(config.target_fps);
+    SerialDriver::setCustomCurve(config.custom_curve);
+    serial.setProfiles(config.profiles, config.profile_count);
+    // Serial has no color order, effects drive the channels as RGB fixtures
+    effects.begin(&serial, config.channel_count / 3, 3);
+
+    if (config.serial2) {
+        serial2.setBreak(config.dmx_break, config.dmx_mab);
+        serial2.begin(&SEROUT2_PORT, config.serial_type, config.channel_count, config.baudrate);
+        serial2.setFullRefresh(config.full_refresh);
+        serial2.setTargetFps(config.target_fps);
+        serial2.setProfiles(config.profiles, config.profile_count, config.serial2_start);
+    }
 
 #endif
 
     LOG_PORT.print(F("- Listening for "));
-    LOG_PORT.print(config.channel_count);
+    LOG_PORT.print(chanLast);
     LOG_PORT.print(F(" channels, from Universe "));
     LOG_PORT.print(config.universe);
     LOG_PORT.print(F(" to "));
@@ -892,6 +1078,8 @@ void dsEffectConfig(const JsonObject &json) {
         config.effect_name = effectsJson["name"].as<String>();
         config.effect_mirror = effectsJson["mirror"];
         config.effect_allleds = effectsJson["allleds"];
+        if (effectsJson.containsKey("white"))
+            config.effect_white = effectsJson["white"];
         config.effect_reverse = effectsJson["reverse"];
         if (effectsJson.containsKey("speed"))
             config.effect_speed = effectsJson["speed"];
@@ -926,6 +1114,12 @@ void dsDeviceConfig(const JsonObject &json) {
         config.channel_start = json["e131"]["channel_start"];
         config.channel_count = json["e131"]["channel_count"];
         config.multicast = json["e131"]["multicast"];
+        if (json["e131"].containsKey("full_refresh"))
+            config.full_refresh = json["e131"]["full_refresh"];
+        if (json["e131"].containsKey("target_fps"))
+            config.target_fps = json["e131"]["target_fps"];
+        if (json["e131"].containsKey("frame_timeout"))
+            config.frame_timeout = json["e131"]["frame_timeout"];
     }
     else
     {
@@ -959,6 +1153,28 @@ void dsDeviceConfig(const JsonObject &json) {
         config.zigSize = json["pixel"]["zigSize"];
         config.gammaVal = json["pixel"]["gammaVal"];
         config.briteVal = json["pixel"]["briteVal"];
+        if (json["pixel"].containsKey("dither"))
+            config.dither = json["pixel"]["dither"];
+        dsColorConfig(json["pixel"]);
+        if (json["pixel"].containsKey("interpolate"))
+            config.interpolate = json["pixel"]["interpolate"];
+        if (json["pixel"].containsKey("powerLimit"))
+            config.power_limit = json["pixel"]["powerLimit"];
+        if (json["pixel"].containsKey("channelMa"))
+            config.channel_ma = json["pixel"]["channelMa"];
+        if (json["pixel"].containsKey("segments"))
+            dsSegments(json["pixel"]["segments"], config.segments, config.seg_count);
+        if (json["pixel"].containsKey("port2")) {
+            JsonObject port2 = json["pixel"]["port2"];
+            config.port2 = port2["enabled"];
+            config.port2_color = PixelColor(static_cast<uint8_t>(port2["color"]));
+            config.port2_start = port2["start"];
+            config.port2_count = port2["count"];
+            config.port2_group = port2["groupSize"];
+            config.port2_zig = port2["zigSize"];
+            if (port2.containsKey("segments"))
+                dsSegments(port2["segments"], config.port2_segments, config.port2_seg_count);
+        }
     }
     else
     {
@@ -970,6 +1186,15 @@ void dsDeviceConfig(const JsonObject &json) {
     if (json.containsKey("serial")) {
         config.serial_type = SerialType(static_cast<uint8_t>(json["serial"]["type"]));
         config.baudrate = BaudRate(static_cast<uint32_t>(json["serial"]["baudrate"]));
+        if (json["serial"].containsKey("dmxBreak"))
+            config.dmx_break = json["serial"]["dmxBreak"];
+        if (json["serial"].containsKey("dmxMab"))
+            config.dmx_mab = json["serial"]["dmxMab"];
+        if (json["serial"].containsKey("port2")) {
+            config.serial2 = json["serial"]["port2"]["enabled"];
+            config.serial2_start = json["serial"]["port2"]["start"];
+        }
+        dsProfiles(json["serial"]);
     }
     else
     {
@@ -982,6 +1207,11 @@ void dsDeviceConfig(const JsonObject &json) {
 void loadConfig() {
     // Zeroize Config struct
     memset(&config, 0, sizeof(config));
+    config.full_refresh = FULL_REFRESH;
+    config.frame_timeout = FRAME_TIMEOUT;
+#if defined(ESPS_MODE_PIXEL)
+    config.channel_ma = POWER_CHANNEL_MA;
+#endif
 
     effects.setFromDefaults();
 
@@ -1006,7 +1236,7 @@ void loadConfig() {
         std::unique_ptr<char[]> buf(new char[size]);
         file.readBytes(buf.get(), size);
 
-        DynamicJsonDocument json(1024);
+        DynamicJsonDocument json(4096);
         DeserializationError error = deserializeJson(json, buf.get());
         if (error) {
             LOG_PORT.println(F("*** Configuration File Format Error ***"));
@@ -1030,7 +1260,7 @@ void loadConfig() {
 // Serialize the current config into a JSON string
 void serializeConfig(String &jsonString, bool pretty, bool creds) {
     // Create buffer and root object
-    DynamicJsonDocument json(1024);
+    DynamicJsonDocument json(4096);
 
     // Device
     JsonObject device = json.createNestedObject("device");
@@ -1063,6 +1293,7 @@ void serializeConfig(String &jsonString, bool pretty, bool creds) {
 
     _effects["mirror"] = config.effect_mirror;
     _effects["allleds"] = config.effect_allleds;
+    _effects["white"] = config.effect_white;
     _effects["reverse"] = config.effect_reverse;
     _effects["speed"] = config.effect_speed;
     _effects["brightness"] = config.effect_brightness;
@@ -1096,6 +1327,9 @@ void serializeConfig(String &jsonString, bool pretty, bool creds) {
     e131["channel_start"] = config.channel_start;
     e131["channel_count"] = config.channel_count;
     e131["multicast"] = config.multicast;
+    e131["full_refresh"] = config.full_refresh;
+    e131["target_fps"] = config.target_fps;
+    e131["frame_timeout"] = config.frame_timeout;
 
 #if defined(ESPS_MODE_PIXEL)
     // Pixel
@@ -1106,12 +1340,36 @@ void serializeConfig(String &jsonString, bool pretty, bool creds) {
     pixel["zigSize"] = config.zigSize;
     pixel["gammaVal"] = config.gammaVal;
     pixel["briteVal"] = config.briteVal;
+    pixel["dither"] = config.dither;
+    pixel["interpolate"] = config.interpolate;
+    pixel["colorTemp"] = config.colorTemp;
+    pixel["powerLimit"] = config.power_limit;
+    pixel["channelMa"] = config.channel_ma;
+    JsonArray balance = pixel.createNestedArray("balance");
+    for (uint8_t i = 0; i < GAMMA_CHANNELS; i++)
+        balance.add(config.balance[i]);
+    serializeSegments(pixel.createNestedArray("segments"), config.segments, config.seg_count);
+    JsonObject port2 = pixel.createNestedObject("port2");
+    port2["enabled"] = config.port2;
+    port2["color"] = static_cast<uint8_t>(config.port2_color);
+    port2["start"] = config.port2_start;
+    port2["count"] = config.port2_count;
+    port2["groupSize"] = config.port2_group;
+    port2["zigSize"] = config.port2_zig;
+    serializeSegments(port2.createNestedArray("segments"), config.port2_segments,
+            config.port2_seg_count);
 
 #elif defined(ESPS_MODE_SERIAL)
     // Serial
     JsonObject serial = json.createNestedObject("serial");
     serial["type"] = static_cast<uint8_t>(config.serial_type);
     serial["baudrate"] = static_cast<uint32_t>(config.baudrate);
+    serial["dmxBreak"] = config.dmx_break;
+    serial["dmxMab"] = config.dmx_mab;
+    JsonObject serial2 = serial.createNestedObject("port2");
+    serial2["enabled"] = config.serial2;
+    serial2["start"] = config.serial2_start;
+    serializeProfiles(serial);
 #endif
 
     if (pretty)
@@ -1121,13 +1379,119 @@ void serializeConfig(String &jsonString, bool pretty, bool creds) {
 }
 
 #if defined(ESPS_MODE_PIXEL)
+// White balance and color temperature, kept when a save doesn't carry them
+void dsColorConfig(const JsonObject &pixel) {
+    if (pixel.containsKey("colorTemp"))
+        config.colorTemp = pixel["colorTemp"];
+    if (pixel.containsKey("balance")) {
+        JsonArray balance = pixel["balance"];
+        for (uint8_t i = 0; i < GAMMA_CHANNELS && i < balance.size(); i++)
+            config.balance[i] = balance[i];
+    }
+}
+
+// Virtual strings, an empty array clears them
+void dsSegments(const JsonArray &json, pixel_segment_t *segments, uint8_t &count) {
+    count = 0;
+    for (JsonObject seg : json) {
+        if (count >= PIXEL_SEGMENTS)
+            break;
+        segments[count].start = seg["start"];
+        segments[count].count = seg["count"];
+        segments[count].nulls = seg["nulls"];
+        segments[count].group = seg["group"];
+        segments[count].reverse = seg["reverse"];
+        segments[count].color = PixelColor(static_cast<uint8_t>(seg["color"]));
+        segments[count].brightness = seg["brightness"];
+        count++;
+    }
+}
+
+void serializeSegments(JsonArray json, const pixel_segment_t *segments, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        JsonObject seg = json.createNestedObject();
+        seg["start"] = segments[i].start;
+        seg["count"] = segments[i].count;
+        seg["nulls"] = segments[i].nulls;
+        seg["group"] = segments[i].group;
+        seg["reverse"] = segments[i].reverse;
+        seg["color"] = static_cast<uint8_t>(segments[i].color);
+        seg["brightness"] = segments[i].brightness;
+    }
+}
+
+// Keep a virtual string table in range, returns the pixels the string needs
+uint16_t validateSegments(pixel_segment_t *segments, uint8_t &count, uint8_t chPixel) {
+    if (count > PIXEL_SEGMENTS)
+        count = PIXEL_SEGMENTS;
+    for (uint8_t i = 0; i < count; i++) {
+        if (segments[i].group < 1)
+            segments[i].group = 1;
+        if (segments[i].brightness > 100)
+            segments[i].brightness = 100;
+        if (segments[i].color > PixelColor::BGRW)
+            segments[i].color = PixelColor::RGB;
+    }
+    return segmentLength(segments, count, chPixel);
+}
+
 void dsGammaConfig(const JsonObject &json) {
     if (json.containsKey("pixel")) {
         config.gammaVal = json["pixel"]["gammaVal"];
         config.briteVal = json["pixel"]["briteVal"];
-        updateGammaTable(config.gammaVal, config.briteVal);
+        dsColorConfig(json["pixel"]);
+        updateGammaTable(config.gammaVal, pixels.setBrightness(config.briteVal),
+            config.balance, config.colorTemp);
+    }
+}
+#elif defined(ESPS_MODE_SERIAL)
+// Curves and fades, each kept when a save doesn't carry it
+void dsProfiles(const JsonObject &serial) {
+    if (serial.containsKey("profiles")) {
+        config.profile_count = 0;
+        for (JsonObject prof : serial["profiles"].as<JsonArray>()) {
+            if (config.profile_count >= SERIAL_PROFILES)
+                break;
+            serial_profile_t &p = config.profiles[config.profile_count++];
+            p.start = prof["start"];
+            p.count = prof["count"];
+            p.curve = SerialCurve(static_cast<uint8_t>(prof["curve"]));
+            p.fade = prof["fade"];
+        }
+    }
+
+    // 256 values as a hex string, a JSON array of them won't fit the document
+    if (serial.containsKey("customCurve")) {
+        const char *hex = serial["customCurve"];
+        if (hex && strlen(hex) == 512) {
+            char byte[3] = { 0 };
+            for (uint16_t i = 0; i < 256; i++) {
+                memcpy(byte, hex + i * 2, 2);
+                config.custom_curve[i] = strtoul(byte, nullptr, 16);
+            }
+        }
     }
 }
+
+void serializeProfiles(JsonObject serial) {
+    JsonArray profiles = serial.createNestedArray("profiles");
+    for (uint8_t i = 0; i < config.profile_count; i++) {
+        JsonObject prof = profiles.createNestedObject();
+        prof["start"] = config.profiles[i].start;
+        prof["count"] = config.profiles[i].count;
+        prof["curve"] = static_cast<uint8_t>(config.profiles[i].curve);
+        prof["fade"] = config.profiles[i].fade;
+    }
+
+    String hex;
+    hex.reserve(512);
+    for (uint16_t i = 0; i < 256; i++) {
+        if (config.custom_curve[i] < 0x10)
+            hex += '0';
+        hex += String(config.custom_curve[i], HEX);
+    }
+    serial["customCurve"] = hex;
+}
 #endif
 
 // Save configuration JSON file
@@ -1158,6 +1522,167 @@ void idleTimeout() {
     }
 }
 
+#if defined(ESPS_MODE_PIXEL)
+uint8_t zcppColourOrder(PixelColor color) {
+    switch(color) {
+      case PixelColor::RBG:
+      case PixelColor::RBGW:
+          return ZCPP_COLOUR_ORDER_RBG;
+      case PixelColor::GRB:
+      case PixelColor::GRBW:
+          return ZCPP_COLOUR_ORDER_GRB;
+      case PixelColor::GBR:
+      case PixelColor::GBRW:
+          return ZCPP_COLOUR_ORDER_GBR;
+      case PixelColor::BRG:
+      case PixelColor::BRGW:
+          return ZCPP_COLOUR_ORDER_BRG;
+      case PixelColor::BGR:
+      case PixelColor::BGRW:
+          return ZCPP_COLOUR_ORDER_BGR;
+      default:
+          return ZCPP_COLOUR_ORDER_RGB;
+    }
+}
+
+// Inverse of zcppColourOrder(), SK6812 strings get the white channel
+PixelColor zcppPixelColor(uint8_t directionColourOrder, bool rgbw) {
+    PixelColor color;
+    switch(ZCPP_GetColourOrder(directionColourOrder)) {
+      case ZCPP_COLOUR_ORDER_RBG:
+          color = PixelColor::RBG;
+          break;
+      case ZCPP_COLOUR_ORDER_GRB:
+          color = PixelColor::GRB;
+          break;
+      case ZCPP_COLOUR_ORDER_GBR:
+          color = PixelColor::GBR;
+          break;
+      case ZCPP_COLOUR_ORDER_BRG:
+          color = PixelColor::BRG;
+          break;
+      case ZCPP_COLOUR_ORDER_BGR:
+          color = PixelColor::BGR;
+          break;
+      case ZCPP_COLOUR_ORDER_RGB:
+          color = PixelColor::RGB;
+          break;
+      default:
+          LOG_PORT.print("Attempt to configure invalid colour order ");
+          LOG_PORT.println(ZCPP_GetColourOrder(directionColourOrder));
+          color = PixelColor::RGB;
+          break;
+    }
+    if (rgbw)
+        color = PixelColor(static_cast<uint8_t>(color) + static_cast<uint8_t>(PixelColor::RGBW));
+    return color;
+}
+
+// Append a ZCPP port / virtual string to a segment table
+void zcppSegment(const ZCPP_PortConfig *p, bool rgbw, pixel_segment_t *segments, uint8_t &count) {
+    if (count >= PIXEL_SEGMENTS) {
+        LOG_PORT.print("Too many virtual strings on port ");
+        LOG_PORT.println(p->port);
+        return;
+    }
+
+    pixel_segment_t &seg = segments[count++];
+    seg.start = std::min<uint32_t>(htonl(p->startChannel), UINT16_MAX);
+    seg.count = htonl(p->channels) / (rgbw ? 4 : 3);
+    seg.nulls = p->nullPixels;
+    seg.group = p->grouping ? p->grouping : 1;
+    seg.reverse = ZCPP_IsReversed(p->directionColourOrder);
+    seg.color = zcppPixelColor(p->directionColourOrder, rgbw);
+    seg.brightness = p->brightness;
+
+    LOG_PORT.print("    Port ");
+    LOG_PORT.print(p->port);
+    LOG_PORT.print(" string ");
+    LOG_PORT.print(ZCPP_GetStringNumber(p->string));
+    LOG_PORT.print(": start ");
+    LOG_PORT.print(seg.start);
+    LOG_PORT.print(" pixels ");
+    LOG_PORT.print(seg.count);
+    LOG_PORT.print(" nulls ");
+    LOG_PORT.print(seg.nulls);
+    LOG_PORT.print(" group ");
+    LOG_PORT.print(seg.group);
+    LOG_PORT.print(seg.reverse ? " reversed" : "");
+    LOG_PORT.print(" colour ");
+    LOG_PORT.print((int)seg.color);
+    LOG_PORT.print(" brightness ");
+    LOG_PORT.println(seg.brightness);
+}
+
+// Make segment starts relative to the first one, returns where that was
+uint16_t zcppRebase(pixel_segment_t *segments, uint8_t count) {
+    uint16_t base = UINT16_MAX;
+    for (uint8_t i = 0; i < count; i++)
+        base = std::min(base, segments[i].start);
+    for (uint8_t i = 0; i < count; i++)
+        segments[i].start -= base;
+    return base;
+}
+
+// True if a segment table is a single string the port settings can describe
+bool zcppPlain(const pixel_segment_t *segments, uint8_t count) {
+    return count == 1 && !segments[0].nulls && !segments[0].reverse;
+}
+
+/*
+* Turn the virtual strings from a ZCPP config into the port config. A port
+* carrying one plain string goes back to the group / brightness settings so
+* it stays editable from the web UI.
+*/
+void zcppApplySegments() {
+    if (config.seg_count) {
+        config.channel_start = zcppRebase(config.segments, config.seg_count);
+        config.pixel_color = config.segments[0].color;
+        config.groupSize = config.segments[0].group;
+        config.channel_count = config.segments[0].count * pixelChannels(config.pixel_color);
+        if (zcppPlain(config.segments, config.seg_count)) {
+            config.briteVal = (float)config.segments[0].brightness / 100.0f;
+            config.seg_count = 0;
+        } else {
+            config.briteVal = 1.0f;     // Each virtual string has its own
+        }
+    }
+
+    // Port 1 is the second string, present only if the config describes it
+    config.port2 = config.port2_seg_count > 0;
+    if (config.port2) {
+        uint16_t base = zcppRebase(config.port2_segments, config.port2_seg_count);
+        config.port2_start = base > config.channel_start ? base - config.channel_start : 0;
+        config.port2_color = config.port2_segments[0].color;
+        config.port2_group = config.port2_segments[0].group;
+        config.port2_count = config.port2_segments[0].count * pixelChannels(config.port2_color);
+        if (zcppPlain(config.port2_segments, config.port2_seg_count) &&
+                config.port2_segments[0].brightness == 100)
+            config.port2_seg_count = 0;
+    }
+}
+
+// Report a segment table as one port config per virtual string
+ZCPP_PortConfig *zcppSegmentPorts(ZCPP_PortConfig *p, uint8_t port, uint8_t protocol,
+        uint32_t base, const pixel_segment_t *segments, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++, p++) {
+        const pixel_segment_t &seg = segments[i];
+        p->port = port;
+        p->string = i;
+        p->protocol = protocol;
+        p->grouping = seg.group;
+        p->startChannel = ntohl(base + seg.start);
+        p->channels = ntohl((uint32_t)seg.count * pixelChannels(seg.color));
+        p->directionColourOrder = zcppColourOrder(seg.color) |
+                (seg.reverse ? ZCPP_REVERSE_MASK : 0);
+        p->nullPixels = seg.nulls;
+        p->brightness = seg.brightness;
+        p->gamma = config.gammaVal * 10;
+    }
+    return p;
+}
+#endif
+
 void sendZCPPConfig(ZCPP_packet_t& packet) {
 
     LOG_PORT.println("Sending ZCPP Configuration query response.");
@@ -1186,11 +1711,25 @@ void sendZCPPConfig(ZCPP_packet_t& packet) {
 #endif
 #if defined(ESPS_MODE_PIXEL)
           case  PixelType::WS2811:
-              packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_WS2811;
+          case  PixelType::WS2811_I2S:
+          case  PixelType::WS2811_7N1:
+              if (pixelChannels(config.pixel_color) == 4)
+                  packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_SK6812;
+              else
+                  packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_WS2811;
               break;
           case  PixelType::GECE:
               packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_GECE;
               break;
+          case  PixelType::APA102:
+              packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_APA102;
+              break;
+          case  PixelType::WS2801:
+              packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_WS2801;
+              break;
+          case  PixelType::LPD8806:
+              packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_LPD8806;
+              break;
 #elif defined(ESPS_MODE_SERIAL)
           case  SerialType::DMX512:
               packet.QueryConfigurationResponse.PortConfig[0].protocol = ZCPP_PROTOCOL_DMX;
@@ -1204,41 +1743,160 @@ void sendZCPPConfig(ZCPP_packet_t& packet) {
 
 #if defined(ESPS_MODE_PIXEL)
         packet.QueryConfigurationResponse.PortConfig[0].grouping = config.groupSize;
-
-        switch(config.pixel_color) {
-          case PixelColor::RGB:
-              packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = ZCPP_COLOUR_ORDER_RGB;
-              break;
-          case PixelColor::RBG:
-              packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = ZCPP_COLOUR_ORDER_RBG;
-              break;
-          case PixelColor::GRB:
-              packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = ZCPP_COLOUR_ORDER_GRB;
-              break;
-          case PixelColor::GBR:
-              packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = ZCPP_COLOUR_ORDER_GBR;
-              break;
-          case PixelColor::BRG:
-              packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = ZCPP_COLOUR_ORDER_BRG;
-              break;
-          case PixelColor::BGR:
-              packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = ZCPP_COLOUR_ORDER_BGR;
-              break;
-        }
+        packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = zcppColourOrder(config.pixel_color);
 
         packet.QueryConfigurationResponse.PortConfig[0].brightness = config.briteVal * 100.0f;
         packet.QueryConfigurationResponse.PortConfig[0].gamma = config.gammaVal * 10;
+
+        // Virtual strings go out as a port config each, the packet has room
+        // for more ports than the struct shows
+        ZCPP_PortConfig *next = &packet.QueryConfigurationResponse.PortConfig[0] + 1;
+        if (config.seg_count)
+            next = zcppSegmentPorts(&packet.QueryConfigurationResponse.PortConfig[0], 0,
+                    packet.QueryConfigurationResponse.PortConfig[0].protocol,
+                    config.channel_start, config.segments, config.seg_count);
+
+        // Second string
+        if (config.port2) {
+            ZCPP_PortConfig *port2 = next++;
+            port2->port = 1;
+            port2->string = 0;
+            port2->startChannel = ntohl((uint32_t)(config.channel_start + config.port2_start));
+            if (pixelChannels(config.port2_color) == 4)
+                port2->protocol = ZCPP_PROTOCOL_SK6812;
+            else
+                port2->protocol = ZCPP_PROTOCOL_WS2811;
+            port2->channels = ntohl((uint32_t)config.port2_count);
+            port2->grouping = config.port2_group;
+            port2->directionColourOrder = zcppColourOrder(config.port2_color);
+            port2->brightness = config.briteVal * 100.0f;
+            port2->gamma = config.gammaVal * 10;
+            if (config.port2_seg_count)
+                next = zcppSegmentPorts(port2, 1, port2->protocol,
+                        config.channel_start + config.port2_start,
+                        config.port2_segments, config.port2_seg_count);
+        }
+        packet.QueryConfigurationResponse.ports = next - packet.QueryConfigurationResponse.PortConfig;
 #else
         packet.QueryConfigurationResponse.PortConfig[0].grouping = 0;
         packet.QueryConfigurationResponse.PortConfig[0].directionColourOrder = 0;
         packet.QueryConfigurationResponse.PortConfig[0].brightness = 100.0f;
         packet.QueryConfigurationResponse.PortConfig[0].gamma = 0;
+
+        // Second universe, same protocol and size on the other UART
+        if (config.serial2) {
+            ZCPP_PortConfig *port2 = &packet.QueryConfigurationResponse.PortConfig[0] + 1;
+            *port2 = packet.QueryConfigurationResponse.PortConfig[0];
+            port2->port = 1 | 0x80;
+            port2->startChannel = ntohl((uint32_t)(config.channel_start + config.serial2_start));
+            packet.QueryConfigurationResponse.ports = 2;
+        }
 #endif
     }
 
     zcpp.sendConfigResponse(&packet);
 }
 
+// Hand a run of output channels over in bulk, split across the ports
+void setOutputs(uint16_t chan, const uint8_t *data, uint16_t len) {
+#if defined(ESPS_MODE_PIXEL)
+    if (chan < config.channel_count)
+        pixels.setValues(chan, data, std::min<uint32_t>(len, config.channel_count - chan));
+    if (config.port2 && chan + len > config.port2_start) {
+        uint16_t skip = chan < config.port2_start ? config.port2_start - chan : 0;
+        uint16_t first = chan + skip - config.port2_start;
+        if (first < config.port2_count)
+            pixels2.setValues(first, data + skip,
+                    std::min<uint32_t>(len - skip, config.port2_count - first));
+    }
+#elif defined(ESPS_MODE_SERIAL)
+    serial.setValues(chan, data, len);
+    if (config.serial2 && chan + len > config.serial2_start) {
+        uint16_t skip = chan < config.serial2_start ? config.serial2_start - chan : 0;
+        serial2.setValues(chan + skip - config.serial2_start, data + skip, len - skip);
+    }
+#endif
+}
+
+/*
+* A DDP / ZCPP frame is whole, commit it on the spot. Waiting for loop()
+* would let the first packet of the next frame join it.
+*/
+void commitFrame() {
+#if defined(ESPS_MODE_PIXEL)
+    pixels.commit(true);
+    if (config.port2)
+        pixels2.commit(true);
+#elif defined(ESPS_MODE_SERIAL)
+    serial.commit();
+    if (config.serial2)
+        serial2.commit();
+#endif
+}
+
+// Network data is only taken while a stream owns the outputs
+bool streaming() {
+    return config.ds == DataSource::E131 || config.ds == DataSource::ZCPP
+            || config.ds == DataSource::DDP || config.ds == DataSource::IDLEWEB;
+}
+
+/*
+* DDP and ZCPP payloads are written to the outputs from the UDP callback,
+* straight out of the received packet. Callbacks run between loop() passes,
+* and should one land while the drivers are mid-frame (something yielded),
+* their commit() holds it until service() is done. The assembler sees each
+* packet before its payload lands, so a frame it completes or abandons is
+* committed without it. Nothing here prints, loop() logs what was counted.
+*/
+void ddpData(uint32_t offset, const uint8_t *data, uint16_t len, bool push) {
+    if (!streaming())
+        return;
+
+    if (offset < chanLast) {
+        len = std::min<uint32_t>(len, chanLast - offset);
+        ddpFrame.add(offset, len);
+        setOutputs(offset, data, len);
+        ddpFrame.written();
+    }
+    if (push)
+        ddpFrame.end();
+}
+
+void zcppData(const ZCPP_Data *packet, uint16_t len) {
+    if (!streaming())
+        return;
+
+    zcppSeen = true;
+
+    // Packets of a newer frame, what's left of the last one isn't coming
+    uint8_t seq = packet->sequenceNumber;
+    if (seq != zcppFrameSeq) {
+        zcppFrame.next();
+        zcppFrameSeq = seq;
+    }
+
+    if (seq != seqZCPPTracker) {
+        seqZCPPWanted = seqZCPPTracker;
+        seqZCPPGot = seq;
+        seqZCPPError++;
+    }
+    if (packet->flags & ZCPP_DATA_FLAG_LAST)
+        seqZCPPTracker = seq + 1;
+
+    uint32_t offset = htonl(packet->frameAddress);
+    if (offset < chanLast) {
+        len = std::min<uint32_t>(len, chanLast - offset);
+        zcppFrame.add(offset, len);
+        setOutputs(offset, packet->data, len);
+        zcppFrame.written();
+    }
+
+    // With a sync coming the frame ends there instead
+    if ((packet->flags & ZCPP_DATA_FLAG_LAST)
+            && !(packet->flags & ZCPP_DATA_FLAG_SYNC_WILL_BE_SENT))
+        zcppFrame.end();
+}
+
 /////////////////////////////////////////////////////////
 //
 //  Main Loop
@@ -1254,7 +1912,7 @@ void loop() {
     bool doShow = true;
 
     // Render output for current data source
-    if ( (config.ds == DataSource::E131) || (config.ds == DataSource::ZCPP) || (config.ds == DataSource::DDP)  || (config.ds == DataSource::IDLEWEB) ) {
+    if (streaming()) {
             // Parse a packet and update pixels
             while (!e131.isEmpty()) {
                 e131_packet_t packet;
@@ -1271,87 +1929,93 @@ void loop() {
                 if ((universe >= config.universe) && (universe <= uniLast)) {
                     // Universe offset and sequence tracking
                     uint8_t uniOffset = (universe - config.universe);
-                    if (packet.sequence_number != seqTracker[uniOffset]++) {
-                        LOG_PORT.print(F("Sequence Error - expected: "));
-                        LOG_PORT.print(seqTracker[uniOffset] - 1);
-                        LOG_PORT.print(F(" actual: "));
-                        LOG_PORT.print(packet.sequence_number);
-                        LOG_PORT.print(F(" universe: "));
-                        LOG_PORT.println(universe);
-                        seqError[uniOffset]++;
-                        seqTracker[uniOffset] = packet.sequence_number + 1;
+                    if (seqTracker[uniOffset] != SEQ_UNSEEN) {
+                        /*
+                        * E1.31 6.7.2: a packet 1 - SEQ_WINDOW behind the next
+                        * one expected, i.e. new - last in (-20, 0], is late
+                        * or a duplicate and newer data already went out for
+                        * this universe. Anything else is taken, a gap just
+                        * means packets were lost.
+                        */
+                        int8_t ahead = packet.sequence_number - seqTracker[uniOffset];
+                        if (ahead < 0 && ahead >= -SEQ_WINDOW) {
+                            seqStale++;
+                            continue;
+                        }
+                        if (ahead) {
+                            LOG_PORT.print(F("Sequence Error - expected: "));
+                            LOG_PORT.print(seqTracker[uniOffset]);
+                            LOG_PORT.print(F(" actual: "));
+                            LOG_PORT.print(packet.sequence_number);
+                            LOG_PORT.print(F(" universe: "));
+                            LOG_PORT.println(universe);
+                            seqError[uniOffset]++;
+                        }
                     }
-
-                    // Offset the channels if required
-                    uint16_t offset = 0;
-                    offset = config.channel_start - 1;
-
-                    // Find start of data based off the Universe
-                    int16_t dataStart = uniOffset * config.universe_limit - offset;
-
-                    // Calculate how much data we need for this buffer
-                    uint16_t dataStop = config.channel_count;
-                    uint16_t channels = htons(packet.property_value_count) - 1;
-                    if (config.universe_limit < channels)
-                        channels = config.universe_limit;
-                    if ((dataStart + channels) < dataStop)
-                        dataStop = dataStart + channels;
-
-                    // Set the data
-                    uint16_t buffloc = 0;
-
-                    // ignore data from start of first Universe before channel_start
-                    if (dataStart < 0) {
-                        dataStart = 0;
-                        buffloc = config.channel_start - 1;
+                    seqTracker[uniOffset] = (packet.sequence_number + 1) & 0xFF;
+
+                    /*
+                    * Stage the universe's span in its slot, a newer packet
+                    * for the same universe overwrites it. Short packets
+                    * only fill what they carry.
+                    */
+                    const universe_map_t &map = uniMap[uniOffset];
+                    uint16_t slots = htons(packet.property_value_count) - 1;
+                    if (slots > map.src) {
+                        uint16_t len = std::min<uint16_t>(map.len, slots - map.src);
+                        if (uniStage && uniFill) {
+                            memcpy(uniStage + map.dst, data + map.src, len);
+                            uniFill[uniOffset] = len;
+                        } else {
+                            setOutputs(map.dst, data + map.src, len);
+                        }
                     }
+                }
+            }
 
-                    for (int i = dataStart; i < dataStop; i++) {
-    #if defined(ESPS_MODE_PIXEL)
-                        pixels.setValue(i, data[buffloc]);
-    #elif defined(ESPS_MODE_SERIAL)
-                        serial.setValue(i, data[buffloc]);
-    #endif
-                        buffloc++;
+            // Each universe goes to the outputs once, from its latest packet
+            if (uniStage && uniFill) {
+                for (uint8_t u = 0; u <= uniLast - config.universe; u++) {
+                    if (uniFill[u]) {
+                        setOutputs(uniMap[u].dst, uniStage + uniMap[u].dst, uniFill[u]);
+                        uniFill[u] = 0;
                     }
                 }
             }
-            while (!ddp.isEmpty()) {
-              DDP_packet_t ddpPacket;
-              ddp.pull(&ddpPacket);
-              if (ddpPacket.header.flags & 0x01) {
-                doShow = true;
-              } else {
-                doShow = false;
-              }
-              uint16_t len = htons(ddpPacket.header.dataLen);
-              uint32_t offset = htonl(ddpPacket.header.channelOffset);
-              bool tc = ddpPacket.header.flags & 0x10;
-              uint8_t *data = ddpPacket.header.data;
-              if (tc) {
-                data = ddpPacket.timeCodeHeader.data;
-              }
-              for (int i = offset; i < offset + len; i++) {
-                if (i < config.channel_count) {
-    #if defined(ESPS_MODE_PIXEL)
-                 pixels.setValue(i, data[i - offset]);
-    #elif defined(ESPS_MODE_SERIAL)
-                 serial.setValue(i, data[i - offset]);
-    #endif
+            // DDP and ZCPP data is already in place, see ddpData() / zcppData()
+            if (zcppSeen) {
+                zcppSeen = false;
+                idleTicker.attach(config.effect_idletimeout, idleTimeout);
+                if (config.ds == DataSource::IDLEWEB || config.ds == DataSource::E131) {
+                    config.ds = DataSource::ZCPP;
                 }
-              }
+            }
+            if (seqZCPPError != seqZCPPLogged) {
+                LOG_PORT.print(F("Sequence Error - expected: "));
+                LOG_PORT.print(seqZCPPWanted);
+                LOG_PORT.print(F(" actual: "));
+                LOG_PORT.print(seqZCPPGot);
+                LOG_PORT.print(F(" errors: "));
+                LOG_PORT.println(seqZCPPError - seqZCPPLogged);
+                seqZCPPLogged = seqZCPPError;
             }
 
             bool abortPacketRead = false;
-            while (!zcpp.isEmpty() && !abortPacketRead) {
+            uint8_t tag;
+            uint16_t len;
+            const uint8_t *record;
+            while (!abortPacketRead && (record = packetRing.front(tag, len))) {
+                // Only ZCPP queues here, DDP always goes to ddpData(). Copied
+                // out, config and discovery replies are built in place
                 ZCPP_packet_t zcppPacket;
+                memcpy(&zcppPacket, record, len);
+                packetRing.pop();
+
                 idleTicker.attach(config.effect_idletimeout, idleTimeout);
                 if (config.ds == DataSource::IDLEWEB || config.ds == DataSource::E131) {
                     config.ds = DataSource::ZCPP;
                 }
 
-                zcpp.pull(&zcppPacket);
-
                 switch (zcppPacket.Discovery.Header.type) {
                   case ZCPP_TYPE_DISCOVERY: // discovery
                       {
@@ -1359,9 +2023,9 @@ void loop() {
                           int pixelPorts = 0;
                           int serialPorts = 0;
         #if defined(ESPS_MODE_PIXEL)
-                            pixelPorts = 1;
+                            pixelPorts = config.port2 ? 2 : 1;
         #elif defined(ESPS_MODE_SERIAL)
-                            serialPorts = 1;
+                            serialPorts = config.serial2 ? 2 : 1;
         #endif
                           char version[9];
                           memset(version, 0x00, sizeof(version));
@@ -1383,17 +2047,44 @@ void loop() {
                         LOG_PORT.print("    Controller Name: ");
                         LOG_PORT.println(config.id);
 
+#if defined(ESPS_MODE_PIXEL)
+                        // Virtual strings can be spread over several packets
+                        if (zcppPacket.Configuration.flags & ZCPP_CONFIG_FLAG_FIRST)
+                            config.seg_count = config.port2_seg_count = 0;
+#else
+                        if (zcppPacket.Configuration.flags & ZCPP_CONFIG_FLAG_FIRST)
+                            config.serial2 = false;
+#endif
+
                         ZCPP_PortConfig* p = zcppPacket.Configuration.PortConfig;
-                        for (int i = 0; i < zcppPacket.Configuration.ports; i++) {
-                            if (p->port == 0) {
+                        for (int i = 0; i < zcppPacket.Configuration.ports; i++, p++) {
+                            if ((p->port & 0x7F) == 0) {
+#if defined(ESPS_MODE_PIXEL)
+                                bool rgbw = false;
+#endif
                                 switch(p->protocol) {
 #if defined(ESPS_MODE_PIXEL)
                                     case ZCPP_PROTOCOL_WS2811:
-                                        config.pixel_type = PixelType::WS2811;
+                                        if (!isWS2811(config.pixel_type))
+                                            config.pixel_type = PixelType::WS2811;
+                                        break;
+                                    case ZCPP_PROTOCOL_SK6812:
+                                        if (!isWS2811(config.pixel_type))
+                                            config.pixel_type = PixelType::WS2811;
+                                        rgbw = true;
                                         break;
                                     case ZCPP_PROTOCOL_GECE:
                                         config.pixel_type = PixelType::GECE;
                                         break;
+                                    case ZCPP_PROTOCOL_APA102:
+                                        config.pixel_type = PixelType::APA102;
+                                        break;
+                                    case ZCPP_PROTOCOL_WS2801:
+                                        config.pixel_type = PixelType::WS2801;
+                                        break;
+                                    case ZCPP_PROTOCOL_LPD8806:
+                                        config.pixel_type = PixelType::LPD8806;
+                                        break;
 #elif defined(ESPS_MODE_SERIAL)
                                     case ZCPP_PROTOCOL_DMX:
                                         config.serial_type = SerialType::DMX512;
@@ -1410,63 +2101,48 @@ void loop() {
                                 LOG_PORT.print("    Protocol: ");
 #if defined(ESPS_MODE_PIXEL)
                                 LOG_PORT.println((int)config.pixel_type);
+                                zcppSegment(p, rgbw, config.segments, config.seg_count);
+                                config.gammaVal = ZCPP_GetGamma(p->gamma);
+                                LOG_PORT.print("    Gamma: ");
+                                LOG_PORT.println(config.gammaVal);
 #elif defined(ESPS_MODE_SERIAL)
                                 LOG_PORT.println((int)config.serial_type);
-#endif
                                 config.channel_start = htonl(p->startChannel);
                                 LOG_PORT.print("    Start Channel: ");
                                 LOG_PORT.println(config.channel_start);
                                 config.channel_count = htonl(p->channels);
                                 LOG_PORT.print("    Channel Count: ");
                                 LOG_PORT.println(config.channel_count);
-#if defined(ESPS_MODE_PIXEL)
-                                config.groupSize = p->grouping;
-                                LOG_PORT.print("    Group Size: ");
-                                LOG_PORT.println(config.groupSize);
-                                switch(ZCPP_GetColourOrder(p->directionColourOrder)) {
-                                    case ZCPP_COLOUR_ORDER_RGB:
-                                      config.pixel_color = PixelColor::RGB;
-                                      break;
-                                    case ZCPP_COLOUR_ORDER_RBG:
-                                      config.pixel_color = PixelColor::RBG;
-                                      break;
-                                    case ZCPP_COLOUR_ORDER_GRB:
-                                      config.pixel_color = PixelColor::GRB;
-                                      break;
-                                    case ZCPP_COLOUR_ORDER_GBR:
-                                      config.pixel_color = PixelColor::GBR;
-                                      break;
-                                    case ZCPP_COLOUR_ORDER_BRG:
-                                      config.pixel_color = PixelColor::BRG;
-                                      break;
-                                    case ZCPP_COLOUR_ORDER_BGR:
-                                      config.pixel_color = PixelColor::BGR;
-                                      break;
-                                    default:
-                                      LOG_PORT.print("Attempt to configure invalid colour order ");
-                                      LOG_PORT.print(ZCPP_GetColourOrder(p->directionColourOrder));
-                                      break;
-                                }
-                                LOG_PORT.print("    Colour Order: ");
-                                LOG_PORT.println((int)config.pixel_color);
-                                config.briteVal = (float)p->brightness / 100.0f;
-                                LOG_PORT.print("    Brightness: ");
-                                LOG_PORT.println(config.briteVal);
-                                config.gammaVal = ZCPP_GetGamma(p->gamma);
-                                LOG_PORT.print("    Gamma: ");
-                                LOG_PORT.println(config.gammaVal);
 #endif
                             }
+#if defined(ESPS_MODE_PIXEL)
+                            else if ((p->port & 0x7F) == 1 && (p->protocol == ZCPP_PROTOCOL_WS2811 ||
+                                    p->protocol == ZCPP_PROTOCOL_SK6812)) {
+                                zcppSegment(p, p->protocol == ZCPP_PROTOCOL_SK6812,
+                                        config.port2_segments, config.port2_seg_count);
+                            }
+#else
+                            else if ((p->port & 0x7F) == 1) {
+                                // Absolute for now, made relative to port 0 once all packets are in
+                                config.serial2 = true;
+                                config.serial2_start = htonl(p->startChannel);
+                            }
+#endif
                             else {
                                 LOG_PORT.print("Attempt to configure invalid port ");
                                 LOG_PORT.print(p->port);
                             }
-
-                            p += sizeof(zcppPacket.Configuration.PortConfig);
                           }
 
                           if (zcppPacket.Configuration.flags & ZCPP_CONFIG_FLAG_LAST) {
                               lastZCPPConfig = htons(zcppPacket.Configuration.sequenceNumber);
+#if defined(ESPS_MODE_PIXEL)
+                              zcppApplySegments();
+#else
+                              if (config.serial2)
+                                  config.serial2_start = config.serial2_start > config.channel_start ?
+                                          config.serial2_start - config.channel_start : 0;
+#endif
                               saveConfig();
                               if ((zcppPacket.Configuration.flags & ZCPP_CONFIG_FLAG_QUERY_CONFIGURATION_RESPONSE_REQUIRED) != 0) {
                                 sendZCPPConfig(zcppPacket);
@@ -1481,46 +2157,22 @@ void loop() {
                       sendZCPPConfig(zcppPacket);
                       break;
                   case ZCPP_TYPE_SYNC: // sync
-                    doShow = true;
+                    zcppFrame.end();
                     // exit read and send data to the pixels
                     abortPacketRead = true;
                     break;
-                  case ZCPP_TYPE_DATA: // data
-                      uint8_t seq = zcppPacket.Data.sequenceNumber;
-                      uint32_t offset = htonl(zcppPacket.Data.frameAddress);
-                      bool frameLast = zcppPacket.Data.flags & ZCPP_DATA_FLAG_LAST;
-                      uint16_t len = htons(zcppPacket.Data.packetDataLength);
-                      bool sync = (zcppPacket.Data.flags & ZCPP_DATA_FLAG_SYNC_WILL_BE_SENT) != 0;
-
-                      if (sync) {
-                        // suppress display until we see a sync
-                        doShow = false;
-                      }
-
-                      if (seq != seqZCPPTracker) {
-                        LOG_PORT.print(F("Sequence Error - expected: "));
-                        LOG_PORT.print(seqZCPPTracker);
-                        LOG_PORT.print(F(" actual: "));
-                        LOG_PORT.println(seq);
-                        seqZCPPError++;
-                      }
-
-                      if (frameLast)
-                        seqZCPPTracker = seq + 1;
-
-                      zcpp.stats.num_packets++;
-
-                      for (int i = offset; i < offset + len; i++) {
-    #if defined(ESPS_MODE_PIXEL)
-                        pixels.setValue(i, zcppPacket.Data.data[i - offset]);
-    #elif defined(ESPS_MODE_SERIAL)
-                        serial.setValue(i, zcppPacket.Data.data[i - offset]);
-    #endif
-                      }
-
-                      break;
                 }
             }
+
+            /*
+            * DDP and ZCPP frames commit themselves when whole, see
+            * commitFrame(), or once they time out. What's in the receive
+            * buffer while one is in progress isn't a frame yet.
+            */
+            ddpFrame.poll();
+            zcppFrame.poll();
+            if (ddpFrame.pending() || zcppFrame.pending())
+                doShow = false;
     }
 
   if (doShow) {
@@ -1532,16 +2184,33 @@ void loop() {
                 effects.run();
         }
 
-    /* Streaming refresh */
+    /* Hand the finished frame to the output governor, effects aren't blended */
     #if defined(ESPS_MODE_PIXEL)
-        if (pixels.canRefresh())
-            pixels.show();
+        bool smooth = config.ds == DataSource::E131 || config.ds == DataSource::DDP
+                || config.ds == DataSource::ZCPP;
+        pixels.commit(smooth);
+        if (config.port2)
+            pixels2.commit(smooth);
     #elif defined(ESPS_MODE_SERIAL)
-        if (serial.canRefresh())
-            serial.show();
+        serial.commit();
+        if (config.serial2)
+            serial2.commit();
     #endif
   }
 
+    /* Streaming refresh */
+    #if defined(ESPS_MODE_PIXEL)
+        pixels.service();
+        if (config.port2)
+            pixels2.service();
+    #elif defined(ESPS_MODE_SERIAL)
+        serial.service();
+        if (config.serial2)
+            serial2.service();
+    #endif
+
+    logSink.handle();
+
 // workaround crash - consume incoming bytes on serial port
     if (LOG_PORT.available()) {
         while (LOG_PORT.read() >= 0);
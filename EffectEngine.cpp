@@ -28,6 +28,7 @@ const EffectDesc EFFECT_LIST[] = {
 #define DEFAULT_EFFECT_REVERSE false
 #define DEFAULT_EFFECT_MIRROR false
 #define DEFAULT_EFFECT_ALLLEDS false
+#define DEFAULT_EFFECT_WHITE false
 #define DEFAULT_EFFECT_SPEED 6
 
 EffectEngine::EffectEngine() {
@@ -42,6 +43,7 @@ void EffectEngine::setFromDefaults() {
     config.effect_reverse = DEFAULT_EFFECT_REVERSE;
     config.effect_mirror = DEFAULT_EFFECT_MIRROR;
     config.effect_allleds = DEFAULT_EFFECT_ALLLEDS;
+    config.effect_white = DEFAULT_EFFECT_WHITE;
     config.effect_speed = DEFAULT_EFFECT_SPEED;
     setFromConfig();
 }
@@ -54,6 +56,7 @@ void EffectEngine::setFromConfig() {
     setReverse(config.effect_reverse);
     setMirror(config.effect_mirror);
     setAllLeds(config.effect_allleds);
+    setWhite(config.effect_white);
     setSpeed(config.effect_speed);
 }
 
@@ -77,9 +80,10 @@ void EffectEngine::setDelay(uint16_t delay) {
         _effectDelay = MIN_EFFECT_DELAY;
 }
 
-void EffectEngine::begin(DRIVER* ledDriver, uint16_t ledCount) {
+void EffectEngine::begin(DRIVER* ledDriver, uint16_t ledCount, uint8_t ledChannels) {
     _ledDriver = ledDriver;
     _ledCount = ledCount;
+    _ledChannels = ledChannels;
     _initialized = true;
 }
 
@@ -147,9 +151,26 @@ bool EffectEngine::isValidEffect(const String effectName) {
 }
 
 void EffectEngine::setPixel(uint16_t idx,  CRGB color) {
-    _ledDriver->setValue(3 * idx + 0, (uint8_t)(color.r * _effectBrightness) );
-    _ledDriver->setValue(3 * idx + 1, (uint8_t)(color.g * _effectBrightness) );
-    _ledDriver->setValue(3 * idx + 2, (uint8_t)(color.b * _effectBrightness) );
+    uint16_t base = _ledChannels * idx;
+    uint8_t r = color.r * _effectBrightness;
+    uint8_t g = color.g * _effectBrightness;
+    uint8_t b = color.b * _effectBrightness;
+
+    // RGBW leds: either leave white off or move the common part of r/g/b to it
+    if (_ledChannels == 4) {
+        uint8_t w = 0;
+        if (_effectWhite) {
+            w = min(r, min(g, b));
+            r -= w;
+            g -= w;
+            b -= w;
+        }
+        _ledDriver->setValue(base + 3, w);
+    }
+
+    _ledDriver->setValue(base + 0, r);
+    _ledDriver->setValue(base + 1, g);
+    _ledDriver->setValue(base + 2, b);
 }
 
 void EffectEngine::setRange(uint16_t first, uint16_t len, CRGB color) {
@@ -63,6 +63,7 @@ private:
     bool _effectReverse             = false;        /* Externally controlled effect reverse option */
     bool _effectMirror              = false;        /* Externally controlled effect mirroring (start at center) */
     bool _effectAllLeds             = false;        /* Externally controlled effect all leds = 1st led */
+    bool _effectWhite               = false;        /* Externally controlled white extraction for RGBW leds */
     float _effectBrightness         = 1.0;          /* Externally controlled effect brightness [0, 255] */
     CRGB _effectColor               = {0,0,0};      /* Externally controlled effect color */
 
@@ -71,17 +72,19 @@ private:
     bool _initialized               = false;        /* Boolean indicating if the engine is initialzied */
     DRIVER* _ledDriver              = nullptr;      /* Pointer to the active LED driver */
     uint16_t _ledCount              = 0;            /* Number of RGB leds (not channels) */
+    uint8_t _ledChannels            = 3;            /* Channels per led, 4 for RGBW */
 
 public:
     EffectEngine();
 
-    void begin(DRIVER* ledDriver, uint16_t ledCount);
+    void begin(DRIVER* ledDriver, uint16_t ledCount, uint8_t ledChannels = 3);
     void run();
 
     String getEffect()                      { return _activeEffect ? _activeEffect->name : ""; }
     bool getReverse()                       { return _effectReverse; }
     bool getMirror()                        { return _effectMirror; }
     bool getAllLeds()                       { return _effectAllLeds; }
+    bool getWhite()                         { return _effectWhite; }
     float getBrightness()                   { return _effectBrightness; }
     uint16_t getDelay()                     { return _effectDelay; }
     uint16_t getSpeed()                     { return _effectSpeed; }
@@ -98,6 +101,7 @@ public:
     void setReverse(bool reverse)           { _effectReverse = reverse; }
     void setMirror(bool mirror)             { _effectMirror = mirror; }
     void setAllLeds(bool allleds)           { _effectAllLeds = allleds; }
+    void setWhite(bool white)               { _effectWhite = white; }
     void setBrightness(float brightness);
     void setSpeed(uint16_t speed);
     void setDelay(uint16_t delay);
@@ -0,0 +1,147 @@
+/*
+* FrameAssembler.cpp - Frame completeness tracking for DDP and ZCPP
+*
+* Project: ESPixelStick - An ESP8266 and E1.31 based pixel driver
+* Copyright (c) 2016 Shelby Merrick
+* http://www.forkineye.com
+*
+*  This program is provided free for you to use in any way that you wish,
+*  subject to the laws and regulations where you are using it.  Due diligence
+*  is strongly suggested before using this code.  Please give credit where due.
+*
+*  The Author makes no warranty of any kind, express or implied, with regard
+*  to this program or the documentation contained in this document.  The
+*  Author shall not be liable in any event for incidental or consequential
+*  damages in connection with, or arising out of, the furnishing, performance
+*  or use of these programs.
+*
+*/
+
+#include <algorithm>
+#include "FrameAssembler.h"
+
+void FrameAssembler::begin(uint16_t timeout, FramePresentCallback present) {
+    this->timeout = timeout;
+    onPresent = present;
+    cntRanges = 0;
+    overflow = ended = false;
+    expFirst = expEnd = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*
+* Channels we already have showing up again mean the sender moved on to
+* the next frame without us seeing the end of this one, e.g. a lost PUSH.
+*/
+void FrameAssembler::add(uint32_t offset, uint32_t len) {
+    if (!len)
+        return;
+    uint32_t first = offset;
+    uint32_t end = offset + len;
+
+    for (uint8_t i = 0; i < cntRanges; i++) {
+        if (ranges[i].first < end && ranges[i].end > first) {
+            next();
+            break;
+        }
+    }
+
+    if (!cntRanges)
+        started = millis();
+
+    // Skip the ranges before, then merge the ones touching this one
+    uint8_t i = 0;
+    while (i < cntRanges && ranges[i].end < first)
+        i++;
+    uint8_t j = i;
+    while (j < cntRanges && ranges[j].first <= end) {
+        first = std::min(first, ranges[j].first);
+        end = std::max(end, ranges[j].end);
+        j++;
+    }
+
+    if (j > i) {
+        ranges[i].first = first;
+        ranges[i].end = end;
+        memmove(ranges + i + 1, ranges + j, (cntRanges - j) * sizeof(range_t));
+        cntRanges -= j - i - 1;
+    } else if (cntRanges < FRAME_RANGES) {
+        memmove(ranges + i + 1, ranges + i, (cntRanges - i) * sizeof(range_t));
+        ranges[i].first = first;
+        ranges[i].end = end;
+        cntRanges++;
+    } else {
+        // Out of ranges, keep the extent but stop trusting the gaps
+        overflow = true;
+        range_t &r = ranges[i < cntRanges ? i : cntRanges - 1];
+        r.first = std::min(r.first, first);
+        r.end = std::max(r.end, end);
+    }
+}
+
+/* The rest of a frame whose end already went by */
+void FrameAssembler::written() {
+    if (cntRanges && ended && complete()) {
+        stats.presented++;
+        stats.late++;
+        present();
+    }
+}
+
+void FrameAssembler::end() {
+    if (!cntRanges)
+        return;
+
+    ended = true;
+    if (complete()) {
+        stats.presented++;
+        present();
+    } else if (!timeout) {
+        stats.torn++;
+        present();
+    }
+}
+
+void FrameAssembler::next() {
+    if (!cntRanges)
+        return;
+
+    if (complete()) {
+        stats.presented++;
+        present();
+    } else {
+        stats.torn++;
+        cntRanges = 0;
+        overflow = ended = false;
+    }
+}
+
+void FrameAssembler::poll() {
+    if (cntRanges && timeout && (millis() - started) >= timeout) {
+        stats.torn++;
+        present();
+    }
+}
+
+/* The first frame has nothing to compare with and counts as complete */
+bool FrameAssembler::complete() {
+    if (overflow)
+        return false;
+    if (!expEnd)
+        return true;
+    for (uint8_t i = 0; i < cntRanges; i++) {
+        if (ranges[i].first <= expFirst && ranges[i].end >= expEnd)
+            return true;
+    }
+    return false;
+}
+
+/* What this frame covered is what the next one has to */
+void FrameAssembler::present() {
+    expFirst = ranges[0].first;
+    expEnd = ranges[cntRanges - 1].end;
+    cntRanges = 0;
+    overflow = ended = false;
+    if (onPresent)
+        onPresent();
+}
@@ -0,0 +1,100 @@
+/*
+* FrameAssembler.h - Frame completeness tracking for DDP and ZCPP
+*
+* Project: ESPixelStick - An ESP8266 and E1.31 based pixel driver
+* Copyright (c) 2016 Shelby Merrick
+* http://www.forkineye.com
+*
+*  This program is provided free for you to use in any way that you wish,
+*  subject to the laws and regulations where you are using it.  Due diligence
+*  is strongly suggested before using this code.  Please give credit where due.
+*
+*  The Author makes no warranty of any kind, express or implied, with regard
+*  to this program or the documentation contained in this document.  The
+*  Author shall not be liable in any event for incidental or consequential
+*  damages in connection with, or arising out of, the furnishing, performance
+*  or use of these programs.
+*
+*/
+
+#ifndef FRAMEASSEMBLER_H_
+#define FRAMEASSEMBLER_H_
+
+#include <Arduino.h>
+
+#define FRAME_RANGES    8       /* Disjoint channel ranges tracked per frame */
+
+/* Assembly statistics */
+typedef struct {
+    uint32_t    presented;  /* Frames shown complete */
+    uint32_t    torn;       /* Frames shown or abandoned with channels missing */
+    uint32_t    late;       /* Frames completed after their PUSH / SYNC */
+} frame_stats_t;
+
+/* Called when a frame is to be shown, commits the outputs */
+typedef void (*FramePresentCallback)();
+
+/*
+* Tracks which channels of the frame in progress have arrived, as a small
+* set of merged ranges, and says when the frame should go out: once it is
+* complete and its end (PUSH / SYNC / LAST) has been seen, or timeout ms
+* after its first data. Complete means covering what the last frame
+* covered, so a sender driving fewer channels than we have doesn't wait
+* out the timeout on every frame.
+*
+* The frame is handed over through the present callback right there, not
+* later from loop(), so a packet of the next frame arriving in between
+* can't join it. Callers add() a packet before writing its payload and
+* call written() after.
+*/
+class FrameAssembler {
+ public:
+    frame_stats_t stats;    // Assembly statistics
+
+    /* Longest wait for a frame after its first data, 0 = go at its end */
+    void begin(uint16_t timeout, FramePresentCallback present);
+
+    /*
+    * Channels offset to offset + len are about to be written. If they
+    * overlap the frame in progress that one is handed over first.
+    */
+    void add(uint32_t offset, uint32_t len);
+
+    /* The payload of the last add() is in place */
+    void written();
+
+    /* The sender marked the end of the frame */
+    void end();
+
+    /* The sender moved on, show the frame in progress if whole, else drop it */
+    void next();
+
+    /* Time out a frame that has waited too long, call from loop() */
+    void poll();
+
+    /* True while a frame has data but hasn't been shown yet */
+    inline bool pending() {
+        return cntRanges;
+    }
+
+ private:
+    typedef struct {
+        uint32_t    first;      // First channel
+        uint32_t    end;        // One past the last channel
+    } range_t;
+
+    range_t     ranges[FRAME_RANGES];   // Arrived so far, sorted and merged
+    uint8_t     cntRanges;      // Ranges in use
+    bool        overflow;       // Too many gaps to track, wait for the timeout
+    uint32_t    expFirst;       // Extent of the last frame shown, expEnd = 0 if none yet
+    uint32_t    expEnd;
+    uint32_t    started;        // millis() of the first data
+    uint16_t    timeout;        // Max ms from first data to show
+    bool        ended;          // End of frame seen
+    FramePresentCallback onPresent;     // Commits the outputs
+
+    bool complete();
+    void present();
+};
+
+#endif /* FRAMEASSEMBLER_H_ */
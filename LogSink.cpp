@@ -0,0 +1,73 @@
+/*
+* LogSink.cpp - Deferred console logging for ESPixelStick
+*
+* Project: ESPixelStick - An ESP8266 and E1.31 based pixel driver
+* Copyright (c) 2016 Shelby Merrick
+* http://www.forkineye.com
+*
+*  This program is provided free for you to use in any way that you wish,
+*  subject to the laws and regulations where you are using it.  Due diligence
+*  is strongly suggested before using this code.  Please give credit where due.
+*
+*  The Author makes no warranty of any kind, express or implied, with regard
+*  to this program or the documentation contained in this document.  The
+*  Author shall not be liable in any event for incidental or consequential
+*  damages in connection with, or arising out of, the furnishing, performance
+*  or use of these programs.
+*
+*/
+
+#include "LogSink.h"
+
+LogSink logSink;
+
+void LogSink::begin(unsigned long baud) {
+    this->baud = baud;
+    head = tail = 0;
+    attached = false;
+    restore();
+}
+
+size_t LogSink::write(uint8_t c) {
+    buffer[head] = c;
+    head = (head + 1) % LOG_SIZE;
+    if (head == tail)   // Full, drop the oldest byte
+        tail = (tail + 1) % LOG_SIZE;
+    handle();
+    return 1;
+}
+
+void LogSink::handle() {
+    if (!attached)
+        return;
+
+    int room = Serial.availableForWrite();
+    while (room-- > 0 && tail != head) {
+        Serial.write(buffer[tail]);
+        tail = (tail + 1) % LOG_SIZE;
+    }
+}
+
+void LogSink::release() {
+    if (!attached)
+        return;
+
+    Serial.flush();
+    attached = false;
+}
+
+void LogSink::restore() {
+    if (attached)
+        return;
+
+    Serial.begin(baud);
+    attached = true;
+}
+
+int LogSink::available() {
+    return attached ? Serial.available() : 0;
+}
+
+int LogSink::read() {
+    return attached ? Serial.read() : -1;
+}
@@ -0,0 +1,60 @@
+/*
+* LogSink.h - Deferred console logging for ESPixelStick
+*
+* Project: ESPixelStick - An ESP8266 and E1.31 based pixel driver
+* Copyright (c) 2016 Shelby Merrick
+* http://www.forkineye.com
+*
+*  This program is provided free for you to use in any way that you wish,
+*  subject to the laws and regulations where you are using it.  Due diligence
+*  is strongly suggested before using this code.  Please give credit where due.
+*
+*  The Author makes no warranty of any kind, express or implied, with regard
+*  to this program or the documentation contained in this document.  The
+*  Author shall not be liable in any event for incidental or consequential
+*  damages in connection with, or arising out of, the furnishing, performance
+*  or use of these programs.
+*
+*/
+
+#ifndef LOGSINK_H_
+#define LOGSINK_H_
+
+#include <Arduino.h>
+
+#define LOG_SIZE    1024    /* Bytes of log kept while UART0 is busy */
+
+/*
+* Log output goes into a ring buffer and is drained to Serial as the TX FIFO
+* has room, with handle() in loop() picking up the rest, so logging never
+* blocks on the UART. When UART0 is handed to an output, the newest
+* LOG_SIZE bytes are kept until it comes back.
+*/
+class LogSink : public Print {
+ public:
+    void begin(unsigned long baud);
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    /* Drain what fits into the Serial TX FIFO */
+    void handle();
+
+    /* Hand UART0 over to an output / take it back at the begin() rate */
+    void release();
+    void restore();
+
+    /* Console input, empty while UART0 is released */
+    int available();
+    int read();
+
+ private:
+    char        buffer[LOG_SIZE];
+    uint16_t    head;           // Next byte to write
+    uint16_t    tail;           // Next byte to drain
+    uint32_t    baud;           // Console baud rate
+    bool        attached;       // UART0 is the console
+};
+
+extern LogSink logSink;
+
+#endif /* LOGSINK_H_ */
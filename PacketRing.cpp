@@ -0,0 +1,99 @@
+/*
+* PacketRing.cpp - Variable length packet queue between the UDP callbacks and loop()
+*
+* Project: ESPixelStick - An ESP8266 and E1.31 based pixel driver
+* Copyright (c) 2016 Shelby Merrick
+* http://www.forkineye.com
+*
+*  This program is provided free for you to use in any way that you wish,
+*  subject to the laws and regulations where you are using it.  Due diligence
+*  is strongly suggested before using this code.  Please give credit where due.
+*
+*  The Author makes no warranty of any kind, express or implied, with regard
+*  to this program or the documentation contained in this document.  The
+*  Author shall not be liable in any event for incidental or consequential
+*  damages in connection with, or arising out of, the furnishing, performance
+*  or use of these programs.
+*
+*/
+
+#include "PacketRing.h"
+
+#define RING_WRAP   0xFFFF  /* Record length marking the rest of the buffer unused */
+
+PacketRing::PacketRing(uint16_t size) : head(0), tail(0) {
+    this->size = size & ~3;
+    if (!(buffer = static_cast<uint8_t *>(malloc(this->size))))
+        this->size = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*
+* head never catches up with tail from behind, head == tail always means
+* empty. So a record may not end right on tail, even when it would fit.
+*/
+bool PacketRing::push(uint8_t tag, const void *data, uint16_t len) {
+    uint32_t need = recordSize(len);
+    uint16_t h = head.load(std::memory_order_relaxed);
+    uint16_t t = tail.load(std::memory_order_acquire);
+    uint16_t at = size;
+
+    if (need >= size) {
+        // Never fits
+    } else if (h >= t) {
+        uint16_t end = size - h;
+        if (end > need || (end == need && t)) {
+            at = h;
+        } else if (t > need) {
+            // Mark the rest unused and start over at the front
+            reinterpret_cast<record_t *>(buffer + h)->len = RING_WRAP;
+            at = 0;
+        }
+    } else if (static_cast<uint16_t>(t - h) > need) {
+        at = h;
+    }
+
+    if (at == size) {
+        stats.overflows++;
+        stats.dropped += len;
+        return false;
+    }
+
+    record_t *rec = reinterpret_cast<record_t *>(buffer + at);
+    rec->len = len;
+    rec->tag = tag;
+    memcpy(buffer + at + sizeof(record_t), data, len);
+    stats.queued++;
+
+    head.store((at + need) % size, std::memory_order_release);
+    return true;
+}
+
+const uint8_t *PacketRing::front(uint8_t &tag, uint16_t &len) {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    uint16_t h = head.load(std::memory_order_acquire);
+    if (t == h)
+        return nullptr;
+
+    // Nothing to read before the end, the record is at the front
+    if (reinterpret_cast<record_t *>(buffer + t)->len == RING_WRAP) {
+        t = 0;
+        tail.store(0, std::memory_order_release);
+        if (t == h)
+            return nullptr;
+    }
+
+    const record_t *rec = reinterpret_cast<record_t *>(buffer + t);
+    tag = rec->tag;
+    len = rec->len;
+    return buffer + t + sizeof(record_t);
+}
+
+void PacketRing::pop() {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+        return;
+
+    const record_t *rec = reinterpret_cast<record_t *>(buffer + t);
+    tail.store((t + recordSize(rec->len)) % size, std::memory_order_release);
+}
@@ -0,0 +1,80 @@
+/*
+* PacketRing.h - Variable length packet queue between the UDP callbacks and loop()
+*
+* Project: ESPixelStick - An ESP8266 and E1.31 based pixel driver
+* Copyright (c) 2016 Shelby Merrick
+* http://www.forkineye.com
+*
+*  This program is provided free for you to use in any way that you wish,
+*  subject to the laws and regulations where you are using it.  Due diligence
+*  is strongly suggested before using this code.  Please give credit where due.
+*
+*  The Author makes no warranty of any kind, express or implied, with regard
+*  to this program or the documentation contained in this document.  The
+*  Author shall not be liable in any event for incidental or consequential
+*  damages in connection with, or arising out of, the furnishing, performance
+*  or use of these programs.
+*
+*/
+
+#ifndef PACKETRING_H_
+#define PACKETRING_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/* Queue statistics */
+typedef struct {
+    uint32_t    queued;     /* Records pushed */
+    uint32_t    overflows;  /* Records dropped for lack of room */
+    uint32_t    dropped;    /* Bytes in the dropped records */
+} packet_ring_stats_t;
+
+/*
+* Single producer / single consumer ring of length prefixed records. Each
+* record is kept in one piece, so loop() can read it in place; a record
+* that doesn't fit before the end leaves a wrap marker and starts over at
+* the front. The producer owns head and the consumer owns tail, each is
+* published with release and read with acquire, so the record bytes are
+* visible before the index that covers them.
+*/
+class PacketRing {
+ public:
+    packet_ring_stats_t stats;  // Producer side statistics
+
+    /* size is rounded down to a multiple of 4 */
+    explicit PacketRing(uint16_t size);
+
+    /* Producer: copy a record in, false if it doesn't fit */
+    bool push(uint8_t tag, const void *data, uint16_t len);
+
+    /* Consumer: the oldest record and its tag / length, nullptr if empty */
+    const uint8_t *front(uint8_t &tag, uint16_t &len);
+
+    /* Consumer: release the record front() returned */
+    void pop();
+
+    inline bool isEmpty() {
+        return tail.load(std::memory_order_relaxed)
+                == head.load(std::memory_order_acquire);
+    }
+
+ private:
+    /* Record header, records are padded to 4 bytes */
+    typedef struct {
+        uint16_t    len;        // Payload length, RING_WRAP for a wrap marker
+        uint8_t     tag;        // Which receiver queued it
+        uint8_t     reserved;
+    } record_t;
+
+    uint8_t                 *buffer;
+    uint16_t                size;
+    std::atomic<uint16_t>   head;   // Next byte to write, producer only
+    std::atomic<uint16_t>   tail;   // Next record to read, consumer only
+
+    static inline uint32_t recordSize(uint16_t len) {
+        return (sizeof(record_t) + len + 3) & ~3;
+    }
+};
+
+#endif /* PACKETRING_H_ */
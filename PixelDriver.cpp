@@ -18,6 +18,7 @@
 */
 
 #include <Arduino.h>
+#include <SPI.h>
 #include <utility>
 #include <algorithm>
 #include "PixelDriver.h"
@@ -28,13 +29,30 @@ extern "C" {
 #include <uart.h>
 #include <uart_register.h>
 }
-
-static const uint8_t    *uart_buffer;       // Buffer tracker
-static const uint8_t    *uart_buffer_tail;  // Buffer tracker
-
-uint8_t PixelDriver::rOffset = 0;
-uint8_t PixelDriver::gOffset = 1;
-uint8_t PixelDriver::bOffset = 2;
+#include <i2s_reg.h>
+
+/* SLC DMA descriptor, as laid out by the hardware */
+struct i2s_desc {
+    uint32_t    blocksize : 12;
+    uint32_t    datalen   : 12;
+    uint32_t    unused    : 5;
+    uint32_t    sub_sof   : 1;
+    uint32_t    eof       : 1;
+    uint32_t    owner     : 1;
+    uint8_t     *buf_ptr;
+    i2s_desc    *next;
+};
+
+static const uint8_t    *uart_buffer[2];        // Buffer tracker per UART
+static const uint8_t    *uart_buffer_tail[2];   // Buffer tracker per UART
+static bool             gece_packet;        // Start bit sent, packet is next
+static i2s_desc         i2s_idle;           // Loops on i2s_zero between frames
+static uint32_t         i2s_zero[I2S_IDLE_SIZE / 4];
+static i2s_desc         *i2s_first;         // First descriptor of the frame
+static i2s_desc         *i2s_last;          // Last descriptor of the frame
+static volatile bool    i2s_busy;           // DMA hasn't reached i2s_last yet
+
+uint8_t PixelDriver::gece_nibble[16][4];
 
 int PixelDriver::begin() {
     return begin(PixelType::WS2811, PixelColor::RGB, 170);
@@ -47,37 +65,58 @@ int PixelDriver::begin(PixelType type) {
 int PixelDriver::begin(PixelType type, PixelColor color, uint16_t length) {
     int retval = true;
 
+    /* Stop the packet timer / DMA before its buffer goes away */
+    if (this->type == PixelType::GECE)
+        timer1_disable();
+    else if (this->type == PixelType::WS2811_I2S)
+        i2s_stop();
+    spiPos = spiEnd = nullptr;
+
+    /* GECE is RGB only, with a 6 bit address */
+    if (type == PixelType::GECE) {
+        color = PixelColor::RGB;
+        length = std::min<uint16_t>(length, GECE_BULBS);
+    }
+
     this->type = type;
     this->color = color;
 
     updateOrder(color);
 
     if (pixdata) free(pixdata);
-    szBuffer = length * 3;
-    if (pixdata = static_cast<uint8_t *>(malloc(szBuffer))) {
+    if (nextdata) free(nextdata);
+    szBuffer = length * chPixel;
+    pixdata = static_cast<uint8_t *>(malloc(szBuffer));
+    nextdata = static_cast<uint8_t *>(malloc(szBuffer));
+    if (pixdata && nextdata) {
         memset(pixdata, 0, szBuffer);
+        memset(nextdata, 0, szBuffer);
         numPixels = length;
+        szDirty = 0;
+        szCommit = szBuffer;    // Clear whatever the string powered up with
     } else {
         numPixels = 0;
         szBuffer = 0;
         retval = false;
     }
 
-    uint16_t szAsync = szBuffer;
-    if (type == PixelType::GECE) {
-        if (pbuff) free(pbuff);
-        if (pbuff = static_cast<uint8_t *>(malloc(GECE_PSIZE))) {
-            memset(pbuff, 0, GECE_PSIZE);
-        } else {
-            numPixels = 0;
-            szBuffer = 0;
-            retval = false;
-        }
-        szAsync = GECE_PSIZE;
-    }
+    /* Frames are pre-encoded, so the async buffer holds UART / SPI bytes */
+    if (type == PixelType::GECE)
+        szAsync = numPixels * GECE_PSIZE;
+    else if (type == PixelType::APA102)
+        szAsync = 4 + szBuffer + numPixels + (numPixels + 15) / 16;
+    else if (type == PixelType::WS2801)
+        szAsync = szBuffer;
+    else if (type == PixelType::LPD8806)
+        szAsync = szBuffer + (numPixels + 31) / 32;
+    else if (type == PixelType::WS2811_7N1)
+        szAsync = (szBuffer * 8 + 2) / 3;
+    else
+        szAsync = szBuffer * WS2811_SYMBOLS;
 
     if (asyncdata) free(asyncdata);
-    if (asyncdata = static_cast<uint8_t *>(malloc(szAsync))) {
+    asyncdata = static_cast<uint8_t *>(malloc(szAsync));
+    if (asyncdata) {
         memset(asyncdata, 0, szAsync);
     } else {
         numPixels = 0;
@@ -85,12 +124,47 @@ int PixelDriver::begin(PixelType type, PixelColor color, uint16_t length) {
         retval = false;
     }
 
+    updateMap();
+    setDither(ditherErr != nullptr);   // Resize for the new buffer
+    setInterpolate(prevdata != nullptr);
+
+    memset(&stats, 0, sizeof(stats));
+    fresh = false;
+    pending = true;     // The cleared frame
+    globalBrite = 31;
+    powerScale = powerTarget = 256;
+    if (!channelMa)
+        channelMa = POWER_CHANNEL_MA;
+
     if (type == PixelType::WS2811) {
-        refreshTime = WS2811_TFRAME * length + WS2811_TIDLE;
+        refreshTime = WS2811_TFRAME * length * chPixel / 3 + WS2811_TIDLE;
+        txTime = refreshTime;
+        ws2811_init();
+    } else if (type == PixelType::WS2811_7N1) {
+        refreshTime = WS2811_7N1_TFRAME * length * chPixel / 3 + WS2811_TIDLE;
+        txTime = refreshTime;
         ws2811_init();
+    } else if (type == PixelType::WS2811_I2S) {
+        refreshTime = WS2811_TFRAME * length * chPixel / 3 + WS2811_TIDLE;
+        txTime = refreshTime;
+        i2s_init();
     } else if (type == PixelType::GECE) {
         refreshTime = (GECE_TFRAME + GECE_TIDLE) * length;
+        txTime = refreshTime;
         gece_init();
+    } else if (type == PixelType::APA102) {
+        refreshTime = szAsync * 8 / (APA102_CLOCK / 1000000L) + 1;
+        txTime = refreshTime;
+        spi_init();
+    } else if (type == PixelType::WS2801) {
+        refreshTime = szAsync * 8 / (WS2801_CLOCK / 1000000L) * WS2801_DUTY +
+                WS2801_TIDLE;
+        txTime = refreshTime;
+        spi_init();
+    } else if (type == PixelType::LPD8806) {
+        refreshTime = szAsync * 8 / (LPD8806_CLOCK / 1000000L) + 1;
+        txTime = refreshTime;
+        spi_init();
     } else {
         retval = false;
     }
@@ -103,30 +177,284 @@ void PixelDriver::setPin(uint8_t pin) {
         this->pin = pin;
 }
 
+void PixelDriver::setGroup(uint16_t _group, uint16_t _zigzag) {
+    this->cntGroup = _group;
+    this->cntZigzag = _zigzag;
+    updateMap();
+}
+
+void PixelDriver::setSegments(const pixel_segment_t *segments, uint8_t count) {
+    cntSegments = std::min<uint8_t>(count, PIXEL_SEGMENTS);
+    memcpy(this->segments, segments, cntSegments * sizeof(pixel_segment_t));
+    updateMap();
+}
+
+uint16_t segmentLength(const pixel_segment_t *segments, uint8_t count,
+        uint8_t chPixel) {
+    uint32_t length = 0;
+    uint32_t source = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const pixel_segment_t &seg = segments[i];
+        uint16_t group = seg.group ? seg.group : 1;
+        length += seg.nulls + seg.count;
+        source = std::max<uint32_t>(source,
+                seg.start + chPixel * ((seg.count + group - 1) / group));
+    }
+    uint32_t pixels = std::max(length, (source + chPixel - 1) / chPixel);
+    return std::min<uint32_t>(pixels, UINT16_MAX);
+}
+
+/*
+* Resolve grouping and zigzag once into a table of source offsets so show()
+* doesn't need any divisions per pixel. No table is kept for a 1:1 layout.
+*/
+void PixelDriver::updateMap() {
+    if (pixmap) free(pixmap);
+    pixmap = nullptr;
+
+    runs[0].end = numPixels;
+    runs[0].scale = 256;
+    runs[0].order = chOffset;
+
+    if (cntSegments) {
+        updateSegments();
+        return;
+    }
+
+    uint16_t group = cntGroup ? cntGroup : 1;
+    if (group == 1 && !cntZigzag)
+        return;
+
+    pixmap = static_cast<uint16_t *>(malloc(numPixels * sizeof(uint16_t)));
+    if (!pixmap)
+        return;
+
+    for (uint16_t led = 0; led < numPixels; led++) {
+        uint16_t modifier = led / group;
+        if (cntZigzag && (led / cntZigzag % 2)) { // Odd "zig"
+            uint16_t start = cntZigzag * (led / cntZigzag);
+            modifier = (start + cntZigzag - (led % cntZigzag) - 1) / group;
+        }
+
+        // A partial last zig can point past the end of the string
+        if (modifier >= numPixels)
+            modifier = numPixels - 1;
+
+        pixmap[led] = chPixel * modifier;
+    }
+}
+
+/*
+* Virtual strings compile into the same source offset table, plus a run per
+* segment carrying its channel order and brightness and a dark run for its
+* null pixels. show() steps through the runs as it goes, so the cost per
+* frame doesn't depend on how many segments there are. Output past the last
+* segment stays dark.
+*/
+void PixelDriver::updateSegments() {
+    pixmap = static_cast<uint16_t *>(malloc(numPixels * sizeof(uint16_t)));
+    if (!pixmap)
+        return;
+
+    uint16_t last = szBuffer >= chPixel ? szBuffer - chPixel : 0;
+    uint16_t led = 0;
+    uint8_t run = 0;
+    for (uint8_t i = 0; i < cntSegments; i++) {
+        const pixel_segment_t &seg = segments[i];
+        uint16_t group = seg.group ? seg.group : 1;
+        colorOffsets(seg.color, segOrder[i]);
+
+        for (uint8_t n = 0; n < seg.nulls && led < numPixels; n++)
+            pixmap[led++] = 0;
+        runs[run].end = led;
+        runs[run].scale = 0;
+        runs[run++].order = chOffset;
+
+        for (uint16_t p = 0; p < seg.count && led < numPixels; p++) {
+            uint16_t src = (seg.reverse ? seg.count - 1 - p : p) / group;
+            pixmap[led++] = std::min<uint32_t>(seg.start + chPixel * src, last);
+        }
+        runs[run].end = led;
+        runs[run].scale = std::min<uint8_t>(seg.brightness, 100) * 256 / 100;
+        runs[run++].order = segOrder[i];
+    }
+
+    while (led < numPixels)
+        pixmap[led++] = 0;
+    runs[run].end = numPixels;
+    runs[run].scale = 0;
+    runs[run].order = chOffset;
+}
+
+void PixelDriver::setTargetFps(uint8_t fps) {
+    frameInterval = fps ? 1000000UL / fps : 0;
+}
+
+/*
+* Output governor. Receivers write straight into pixdata and commit() once a
+* frame is complete, which swaps it with nextdata. Only nextdata is ever
+* encoded, so refreshes in between never pick up half of the next frame.
+* service() runs every loop and sends the newest committed frame at the
+* first free slot, so the last frame of a burst always makes it out. A frame
+* committed while the string is still busy counts as late, one overwritten
+* by a newer commit before it went out counts as coalesced.
+*/
+void PixelDriver::commit(bool smooth) {
+    if (servicing) {
+        deferred = true;
+        deferSmooth = smooth;
+        return;
+    }
+    if (!fresh) return;
+    fresh = false;
+
+    if (pending)
+        stats.coalesced++;
+    else if (isBusy() || !canRefresh())
+        stats.late++;
+    pending = true;
+
+    if (prevdata)
+        snapshot(smooth);
+
+    /*
+    * The old frame comes back as the receive buffer, it only lags the new
+    * one by the channels written since the last commit.
+    */
+    std::swap(pixdata, nextdata);
+    memcpy(pixdata, nextdata, szDirty);
+    szCommit = std::max(szCommit, szDirty);
+    szDirty = 0;
+}
+
+/*
+* Interpolation blends from prevdata to nextdata over the time since the
+* previous commit, so the output trails the input by at most one frame.
+* prevdata picks up wherever the last blend had got to, so a frame arriving
+* early doesn't jump. Slow sources, frames the string can't refresh between,
+* and frames where a quarter of the channels jump are shown as is.
+*/
+void PixelDriver::snapshot(bool smooth) {
+    uint16_t t = blendPos();
+    uint16_t jumps = 0;
+    for (uint16_t i = 0; i < szBuffer; i++) {
+        uint8_t from = lerp(prevdata[i], nextdata[i], t);
+        prevdata[i] = from;
+        if (abs(pixdata[i] - from) > INTERP_CUT)
+            jumps++;
+    }
+
+    uint32_t now = micros();
+    uint32_t interval = now - commitTime;
+    commitTime = now;
+
+    blendTime = interval;
+    if (!smooth || interval > INTERP_MAX || interval < 2 * refreshTime ||
+            jumps > szBuffer / 4)
+        blendTime = 0;
+}
+
+void PixelDriver::service() {
+    if (spiPos != spiEnd)
+        writeSPI();
+    if (isBusy() || !canRefresh())
+        return;
+
+    servicing = true;
+    if (pending) {
+        pending = false;
+        stats.presented++;
+        show();
+    } else if (ditherErr || powerScale < powerTarget ||
+            (prevdata && blendPos() < 256) ||
+            (millis() - fullTime) >= fullRefresh) {
+        show();     // Keep dithering / ramping / blending or refresh what's out
+    }
+    servicing = false;
+
+    if (deferred) {
+        deferred = false;
+        commit(deferSmooth);
+    }
+}
+
+void PixelDriver::setInterpolate(bool interpolate) {
+    if (prevdata) free(prevdata);
+    prevdata = nullptr;
+    blendTime = 0;
+
+    if (interpolate && nextdata &&
+            (prevdata = static_cast<uint8_t *>(malloc(szBuffer))))
+        memcpy(prevdata, nextdata, szBuffer);
+}
+
+void PixelDriver::setPowerLimit(uint16_t budget, uint8_t channelMa) {
+    powerBudget = budget;
+    this->channelMa = channelMa ? channelMa : POWER_CHANNEL_MA;
+    powerScale = powerTarget = 256;
+}
+
+/*
+* level is the sum of the corrected subpixels of a full frame. The limiter
+* only sees it once the frame is out, so it cuts straight down to the budget
+* on the next frame and ramps back up over a few frames once there is room.
+*/
+void PixelDriver::updatePower(uint32_t level) {
+    stats.current = level * channelMa / 255;
+    if (stats.current > stats.peak)
+        stats.peak = stats.current;
+
+    powerTarget = 256;
+    if (powerBudget && stats.current > powerBudget)
+        powerTarget = static_cast<uint32_t>(powerBudget) * 256 / stats.current;
+
+    if (powerTarget < powerScale)
+        powerScale = powerTarget;
+    else
+        powerScale = std::min<uint16_t>(powerScale + POWER_RAMP, powerTarget);
+}
+
+void PixelDriver::setDither(bool dither) {
+    if (ditherErr) free(ditherErr);
+    ditherErr = nullptr;
+
+    if (dither && (ditherErr = static_cast<uint8_t *>(malloc(szBuffer))))
+        memset(ditherErr, 0, szBuffer);
+}
+
 void PixelDriver::ws2811_init() {
-    /* Serial rate is 4x 800KHz for WS2811 */
-    Serial1.begin(3200000, SERIAL_6N1, SERIAL_TX_ONLY);
-    CLEAR_PERI_REG_MASK(UART_CONF0(UART), UART_INV_MASK);
-    SET_PERI_REG_MASK(UART_CONF0(UART), (BIT(22)));
+    /*
+    * Serial rate is 4x 800KHz for WS2811, 2 bits per 6N1 symbol. The 7N1
+    * encoding runs 3 UART bits per data bit instead and packs 3 per symbol.
+    */
+    HardwareSerial &port = uart ? Serial1 : Serial;
+    if (type == PixelType::WS2811_7N1)
+        port.begin(WS2811_7N1_BAUD, SERIAL_7N1, SERIAL_TX_ONLY);
+    else
+        port.begin(3200000, SERIAL_6N1, SERIAL_TX_ONLY);
+    CLEAR_PERI_REG_MASK(UART_CONF0(uart), UART_INV_MASK);
+    SET_PERI_REG_MASK(UART_CONF0(uart), (BIT(22)));
 
     /* Clear FIFOs */
-    SET_PERI_REG_MASK(UART_CONF0(UART), UART_RXFIFO_RST | UART_TXFIFO_RST);
-    CLEAR_PERI_REG_MASK(UART_CONF0(UART), UART_RXFIFO_RST | UART_TXFIFO_RST);
+    SET_PERI_REG_MASK(UART_CONF0(uart), UART_RXFIFO_RST | UART_TXFIFO_RST);
+    CLEAR_PERI_REG_MASK(UART_CONF0(uart), UART_RXFIFO_RST | UART_TXFIFO_RST);
 
     /* Disable all interrupts */
     ETS_UART_INTR_DISABLE();
+    uart_buffer[uart] = uart_buffer_tail[uart] = nullptr;
 
-    /* Atttach interrupt handler */
+    /* Atttach interrupt handler, shared by both UARTs */
     ETS_UART_INTR_ATTACH(handleWS2811, NULL);
 
     /* Set TX FIFO trigger. 80 bytes gives 200 microsecs to refill the FIFO */
-    WRITE_PERI_REG(UART_CONF1(UART), 80 << UART_TXFIFO_EMPTY_THRHD_S);
+    WRITE_PERI_REG(UART_CONF1(uart), 80 << UART_TXFIFO_EMPTY_THRHD_S);
 
     /* Disable RX & TX interrupts. It is enabled by uart.c in the SDK */
-    CLEAR_PERI_REG_MASK(UART_INT_ENA(UART), UART_RXFIFO_FULL_INT_ENA | UART_TXFIFO_EMPTY_INT_ENA);
+    CLEAR_PERI_REG_MASK(UART_INT_ENA(uart),
+            UART_RXFIFO_FULL_INT_ENA | UART_TXFIFO_EMPTY_INT_ENA);
 
-    /* Clear all pending interrupts in UART1 */
-    WRITE_PERI_REG(UART_INT_CLR(UART), 0xffff);
+    /* Clear all pending interrupts in the UART */
+    WRITE_PERI_REG(UART_INT_CLR(uart), 0xffff);
 
     /* Reenable interrupts */
     ETS_UART_INTR_ENABLE();
@@ -137,164 +465,525 @@ void PixelDriver::gece_init() {
     Serial1.begin(300000, SERIAL_7N1, SERIAL_TX_ONLY);
     SET_PERI_REG_MASK(UART_CONF0(UART), UART_TXD_BRK);
     delayMicroseconds(GECE_TIDLE);
+    uart_buffer[UART] = uart_buffer_tail[UART] = nullptr;
+
+    /* Expand LOOKUP_GECE so packets are encoded 4 bits at a time */
+    for (uint8_t nib = 0; nib < 16; nib++)
+        for (uint8_t bit = 0; bit < 4; bit++)
+            gece_nibble[nib][bit] = LOOKUP_GECE[(nib >> (3 - bit)) & 0x1];
+
+    /* Packets are paced by timer1, one shot per start bit / packet */
+    timer1_isr_init();
+    timer1_attachInterrupt(handleGECE);
+}
+
+/*
+* WS2811 on the I2S data pin (GPIO3 / RX) with the SLC DMA feeding it, so
+* nothing on the CPU side can stall a frame once it's started. Between
+* frames the DMA loops on a zeroed descriptor, which holds the line low.
+*/
+void PixelDriver::i2s_init() {
+    uart_buffer[uart] = uart_buffer_tail[uart] = nullptr;
+    i2s_busy = false;
+
+    /* One descriptor per I2S_DESC_MAX bytes of the frame */
+    if (i2sDesc) free(i2sDesc);
+    uint16_t cnt = (szAsync + I2S_DESC_MAX - 1) / I2S_DESC_MAX;
+    i2sDesc = static_cast<i2s_desc *>(calloc(cnt ? cnt : 1, sizeof(i2s_desc)));
+
+    memset(i2s_zero, 0, sizeof(i2s_zero));
+    memset(&i2s_idle, 0, sizeof(i2s_idle));
+    i2s_idle.blocksize = i2s_idle.datalen = sizeof(i2s_zero);
+    i2s_idle.owner = 1;
+    i2s_idle.buf_ptr = reinterpret_cast<uint8_t *>(i2s_zero);
+    i2s_idle.next = &i2s_idle;
+
+    /* Reset the SLC and point its RX (memory -> I2S) side at the idle loop */
+    ETS_SLC_INTR_DISABLE();
+    SLCC0 |= SLCRXLR | SLCTXLR;
+    SLCC0 &= ~(SLCRXLR | SLCTXLR);
+    SLCIC = 0xFFFFFFFF;
+    SLCC0 &= ~(SLCMM << SLCM);
+    SLCC0 |= (1 << SLCM);
+    SLCRXDC |= SLCBINR | SLCBTNR;
+    SLCRXDC &= ~(SLCBRXFE | SLCBRXEM | SLCBRXFM);
+    SLCTXL &= ~(SLCTXLAM << SLCTXLA);
+    SLCTXL |= reinterpret_cast<uintptr_t>(&i2s_idle) << SLCTXLA;
+    SLCRXL &= ~(SLCRXLAM << SLCRXLA);
+    SLCRXL |= reinterpret_cast<uintptr_t>(&i2s_idle) << SLCRXLA;
+    ETS_SLC_INTR_ATTACH(handleI2S, NULL);
+    SLCIE = SLCIRXEOF;
+    ETS_SLC_INTR_ENABLE();
+    SLCTXL |= SLCTXLS;
+    SLCRXL |= SLCRXLS;
+
+    pinMode(3, FUNCTION_1);
+
+    /* Reset I2S, TX from DMA, 16 bit stereo */
+    I2S_CLK_ENABLE();
+    I2SIC = 0x3F;
+    I2SIE = 0;
+    I2SC &= ~(I2SRST);
+    I2SC |= I2SRST;
+    I2SC &= ~(I2SRST);
+    I2SFC &= ~(I2SDE | (I2STXFMM << I2STXFM) | (I2SRXFMM << I2SRXFM));
+    I2SFC |= I2SDE;
+    I2SCC &= ~((I2STXCMM << I2STXCM) | (I2SRXCMM << I2SRXCM));
+
+    /* Bit clock is 4x 800KHz, 160MHz / 10 / 5 */
+    I2SC &= ~(I2STXR);
+    I2SC &= ~((I2SBDM << I2SBD) | (I2SCDM << I2SCD));
+    I2SC |= I2SRF | I2SMR | I2SRSM | I2SRMS | (5 << I2SBD) | (10 << I2SCD);
+    I2SC |= I2STXS;
 }
 
+void PixelDriver::i2s_stop() {
+    ETS_SLC_INTR_DISABLE();
+    SLCIC = 0xFFFFFFFF;
+    SLCIE = 0;
+    SLCTXL &= ~(SLCTXLAM << SLCTXLA);
+    SLCRXL &= ~(SLCRXLAM << SLCRXLA);
+    I2SC &= ~(I2STXS);
+    pinMode(3, INPUT);
+    i2s_busy = false;
+}
+
+void PixelDriver::writeSPI() {
+    uint16_t len = spiEnd - spiPos;
+    if (type != PixelType::WS2801)
+        len = std::min<uint16_t>(len, SPI_CHUNK);
+    SPI.writeBytes(spiPos, len);
+    spiPos += len;
+}
+
+/* Hardware SPI at the clock rate of the chip */
+void PixelDriver::spi_init() {
+    uart_buffer[uart] = uart_buffer_tail[uart] = nullptr;
+
+    SPI.begin();
+    SPI.setDataMode(SPI_MODE0);
+    SPI.setBitOrder(MSBFIRST);
+    if (type == PixelType::APA102)
+        SPI.setFrequency(APA102_CLOCK);
+    else if (type == PixelType::WS2801)
+        SPI.setFrequency(WS2801_CLOCK);
+    else
+        SPI.setFrequency(LPD8806_CLOCK);
+}
+
+float PixelDriver::setBrightness(float briteVal) {
+    globalBrite = 31;
+    if (type != PixelType::APA102 || briteVal <= 0)
+        return briteVal;
+
+    globalBrite = ceil(briteVal * 31.0);
+    if (globalBrite > 31)
+        globalBrite = 31;
+    return briteVal * 31.0 / globalBrite;
+}
+
+/*
+* Resolve the color order into a stride and the source channel of each
+* output byte. Only call through begin(), the stride sizes the buffers.
+*/
 void PixelDriver::updateOrder(PixelColor color) {
     this->color = color;
 
+    chPixel = pixelChannels(color);
+    colorOffsets(color, chOffset);
+}
+
+void PixelDriver::colorOffsets(PixelColor color, uint8_t *offset) {
+    offset[3] = 3;      // White always goes out last
+
     switch (color) {
         case PixelColor::GRB:
-            rOffset = 1;
-            gOffset = 0;
-            bOffset = 2;
+        case PixelColor::GRBW:
+            offset[0] = 1;
+            offset[1] = 0;
+            offset[2] = 2;
             break;
         case PixelColor::BRG:
-            rOffset = 1;
-            gOffset = 2;
-            bOffset = 0;
+        case PixelColor::BRGW:
+            offset[0] = 1;
+            offset[1] = 2;
+            offset[2] = 0;
             break;
         case PixelColor::RBG:
-            rOffset = 0;
-            gOffset = 2;
-            bOffset = 1;
+        case PixelColor::RBGW:
+            offset[0] = 0;
+            offset[1] = 2;
+            offset[2] = 1;
             break;
         case PixelColor::GBR:
-            rOffset = 2;
-            gOffset = 0;
-            bOffset = 1;
+        case PixelColor::GBRW:
+            offset[0] = 2;
+            offset[1] = 0;
+            offset[2] = 1;
             break;
         case PixelColor::BGR:
-            rOffset = 2;
-            gOffset = 1;
-            bOffset = 0;
+        case PixelColor::BGRW:
+            offset[0] = 2;
+            offset[1] = 1;
+            offset[2] = 0;
             break;
         default:
-            rOffset = 0;
-            gOffset = 1;
-            bOffset = 2;
+            offset[0] = 0;
+            offset[1] = 1;
+            offset[2] = 2;
     }
 }
 
+/* One handler refills whichever UARTs have a string on them */
 void ICACHE_RAM_ATTR PixelDriver::handleWS2811(void *param) {
-    /* Process if UART1 */
-    if (READ_PERI_REG(UART_INT_ST(UART1))) {
+    for (uint8_t u = UART0; u <= UART1; u++) {
+        if (!READ_PERI_REG(UART_INT_ST(u)))
+            continue;
+
         // Fill the FIFO with new data
-        uart_buffer = fillWS2811(uart_buffer, uart_buffer_tail);
+        uart_buffer[u] = fillWS2811(u, uart_buffer[u], uart_buffer_tail[u]);
 
         // Disable TX interrupt when done
-        if (uart_buffer == uart_buffer_tail)
-            CLEAR_PERI_REG_MASK(UART_INT_ENA(UART1), UART_TXFIFO_EMPTY_INT_ENA);
+        if (uart_buffer[u] == uart_buffer_tail[u])
+            CLEAR_PERI_REG_MASK(UART_INT_ENA(u), UART_TXFIFO_EMPTY_INT_ENA);
 
         // Clear all interrupts flags (just in case)
-        WRITE_PERI_REG(UART_INT_CLR(UART1), 0xffff);
+        WRITE_PERI_REG(UART_INT_CLR(u), 0xffff);
     }
-
-    /* Clear if UART0 */
-    if (READ_PERI_REG(UART_INT_ST(UART0)))
-        WRITE_PERI_REG(UART_INT_CLR(UART0), 0xffff);
 }
 
-const uint8_t* ICACHE_RAM_ATTR PixelDriver::fillWS2811(const uint8_t *buff,
-        const uint8_t *tail) {
-    uint8_t avail = (UART_TX_FIFO_SIZE - getFifoLength()) / 4;
+const uint8_t* ICACHE_RAM_ATTR PixelDriver::fillWS2811(uint8_t uart,
+        const uint8_t *buff, const uint8_t *tail) {
+    uint8_t avail = UART_TX_FIFO_SIZE - getFifoLength(uart);
     if (tail - buff > avail)
         tail = buff + avail;
 
-    while (buff + 2 < tail) {
-        uint8_t subpix = buff[rOffset];
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 6) & 0x3]);
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 4) & 0x3]);
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 2) & 0x3]);
-        enqueue(LOOKUP_2811[GAMMA_TABLE[subpix] & 0x3]);
-
-        subpix = buff[gOffset];
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 6) & 0x3]);
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 4) & 0x3]);
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 2) & 0x3]);
-        enqueue(LOOKUP_2811[GAMMA_TABLE[subpix] & 0x3]);
-
-        subpix = buff[bOffset];
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 6) & 0x3]);
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 4) & 0x3]);
-        enqueue(LOOKUP_2811[(GAMMA_TABLE[subpix] >> 2) & 0x3]);
-        enqueue(LOOKUP_2811[GAMMA_TABLE[subpix] & 0x3]);
-
-        buff += 3;
-    }
+    while (buff < tail)
+        enqueue(uart, *buff++);
 
     return buff;
 }
 
-void ICACHE_RAM_ATTR PixelDriver::show() {
-    if (!pixdata) return;
+/*
+* Each GECE packet is a 10us start bit followed by 26 bits, then the line
+* idles low (break) until the next packet is due. The break is only
+* asserted by the UART once the FIFO has drained.
+*/
+void ICACHE_RAM_ATTR PixelDriver::handleGECE() {
+    if (!gece_packet) {
+        // 10us start bit
+        CLEAR_PERI_REG_MASK(UART_CONF0(UART), UART_TXD_BRK);
+        gece_packet = true;
+        timer1_write(GECE_TICKS(GECE_TSTART));
+    } else {
+        // Send packet and idle low (break)
+        for (uint8_t i = 0; i < GECE_PSIZE; i++)
+            enqueue(UART, *uart_buffer[UART]++);
+        SET_PERI_REG_MASK(UART_CONF0(UART), UART_TXD_BRK);
+        gece_packet = false;
+
+        // Wait out the frame and idle time before the next start bit
+        if (uart_buffer[UART] < uart_buffer_tail[UART])
+            timer1_write(GECE_TICKS(GECE_TFRAME + GECE_TIDLE - GECE_TSTART));
+        else
+            timer1_disable();
+    }
+}
 
-    if (type == PixelType::WS2811) {
-        if (!cntZigzag) {  // Normal / group copy
-            for (size_t led = 0; led < szBuffer / 3; led++) {
-                uint16 modifier = led / cntGroup;
-                asyncdata[3 * led + 0] = pixdata[3 * modifier + 0];
-                asyncdata[3 * led + 1] = pixdata[3 * modifier + 1];
-                asyncdata[3 * led + 2] = pixdata[3 * modifier + 2];
-            }
-        } else {  // Zigzag copy
-            for (size_t led = 0; led < szBuffer / 3; led++) {
-                uint16 modifier = led / cntGroup;
-                if (led / cntZigzag % 2) { // Odd "zig"
-                    int group = cntZigzag * (led / cntZigzag);
-                    int this_led = (group + cntZigzag - (led % cntZigzag) - 1) / cntGroup;
-                    asyncdata[3 * led + 0] = pixdata[3 * this_led + 0];
-                    asyncdata[3 * led + 1] = pixdata[3 * this_led + 1];
-                    asyncdata[3 * led + 2] = pixdata[3 * this_led + 2];
-                } else { // Even "zag"
-                    asyncdata[3 * led + 0] = pixdata[3 * modifier + 0];
-                    asyncdata[3 * led + 1] = pixdata[3 * modifier + 1];
-                    asyncdata[3 * led + 2] = pixdata[3 * modifier + 2];
-                }
-            }
+/*
+* EOF is only flagged on the first and last descriptor of a frame. Once the
+* first is done the DMA has left the idle loop, so it can be closed again
+* and the DMA parks there after the last one.
+*/
+void ICACHE_RAM_ATTR PixelDriver::handleI2S(void *param) {
+    uint32_t status = SLCIS;
+    SLCIC = 0xFFFFFFFF;
+
+    if (status & SLCIRXEOF) {
+        i2s_desc *done = reinterpret_cast<i2s_desc *>(SLCRXEOFA);
+        if (done == i2s_first)
+            i2s_idle.next = &i2s_idle;
+        if (done == i2s_last)
+            i2s_busy = false;
+    }
+}
+
+bool PixelDriver::isBusy() {
+    if (type == PixelType::WS2811_I2S)
+        return i2s_busy;
+    if (isClocked(type))
+        return spiPos != spiEnd;
+    return uart_buffer[uart] != uart_buffer_tail[uart];
+}
 
+void ICACHE_RAM_ATTR PixelDriver::show() {
+    if (!pixdata || !numPixels) return;
+
+    /*
+    * nextdata is the back buffer and asyncdata the front one. Hold off
+    * while the ISR still owns asyncdata, the frame stays in nextdata until
+    * the next call.
+    */
+    if (isBusy()) return;
+
+    /*
+    * Pixels latch their last value, so an unchanged frame isn't resent and
+    * a changed one stops after the last changed pixel. Dithering changes
+    * the output every frame and grouping / zigzag / virtual strings can
+    * move a source pixel anywhere, so those always send the whole string.
+    * The power limiter needs the whole frame to estimate it and
+    * interpolation blends all of it, so those send it all too. A full
+    * frame still goes out every fullRefresh ms in case a pixel missed an
+    * update.
+    */
+    bool full = (millis() - fullTime) >= fullRefresh;
+    bool ramp = powerScale < powerTarget;
+    uint16_t blend = prevdata ? blendPos() : 256;
+    if (!szCommit && !full && !ditherErr && !ramp && blend == 256)
+        return;
+
+    uint16_t count = numPixels;
+    if (!full && !ditherErr && !pixmap && !powerBudget && !prevdata)
+        count = (szCommit + chPixel - 1) / chPixel;
+    if (count == numPixels)
+        fullTime = millis();
+    szCommit = 0;
+
+    /* Power estimate and limiting ride along with the gamma lookup */
+    uint32_t level = 0;
+    uint16_t scale = powerScale;
+
+    const uint8_t *src = nextdata;
+
+    if (isWS2811(type)) {
+        /*
+        * Grouping, gamma, color order and the UART / I2S encoding are all
+        * done here so handleWS2811() only has to copy symbols into the FIFO
+        * and the DMA can stream the frame as is.
+        */
+        bool i2s = type == PixelType::WS2811_I2S;
+        bool dense = type == PixelType::WS2811_7N1;
+        uint16_t acc = 0;
+        uint8_t bits = 0;
+        uint8_t *out = asyncdata;
+        uint8_t *err = ditherErr;
+        const pixel_run_t *run = runs;
+        for (size_t led = 0; led < count; led++) {
+            while (led == run->end)
+                run++;
+            uint16_t offset = pixmap ? pixmap[led] : chPixel * led;
+            const uint8_t *pixel = src + offset;
+            for (uint8_t ch = 0; ch < chPixel; ch++) {
+                uint8_t srcCh = run->order[ch];
+                uint8_t in = pixel[srcCh];
+                if (blend < 256)
+                    in = lerp(prevdata[offset + srcCh], in, blend);
+                if (run->scale < 256)
+                    in = (in * run->scale) >> 8;
+                uint8_t val = err ? dither(GAMMA_TABLE16[srcCh], in, *err++)
+                                  : GAMMA_TABLE[srcCh][in];
+                level += val;
+                if (scale < 256)
+                    val = (val * scale) >> 8;
+                if (dense)
+                    out = encodeWS2811_7N1(out, val, acc, bits);
+                else if (i2s)
+                    out = reinterpret_cast<uint8_t *>(
+                            encodeI2S(reinterpret_cast<uint16_t *>(out), val));
+                else
+                    out = encodeWS2811(out, val);
+            }
         }
 
-        uart_buffer = asyncdata;
-        uart_buffer_tail = asyncdata + szBuffer;
+        /* Pad the last 7N1 symbol with zero bits, the string drops them */
+        if (bits)
+            *out++ = LOOKUP_2811_7N1[(acc << (3 - bits)) & 0x7];
 
-        SET_PERI_REG_MASK(UART_INT_ENA(1), UART_TXFIFO_EMPTY_INT_ENA);
         startTime = micros();
+        uint32_t tframe = dense ? WS2811_7N1_TFRAME : WS2811_TFRAME;
+        txTime = tframe * count * chPixel / 3 + WS2811_TIDLE;
+
+        if (!i2s) {
+            uart_buffer[uart] = asyncdata;
+            uart_buffer_tail[uart] = out;
+            SET_PERI_REG_MASK(UART_INT_ENA(uart), UART_TXFIFO_EMPTY_INT_ENA);
+        } else if (i2sDesc) {
+            /* Chain the frame after the idle loop, the DMA takes it on */
+            uint8_t *buf = asyncdata;
+            uint16_t left = out - asyncdata;
+            i2s_desc *desc = i2sDesc;
+            while (true) {
+                uint16_t len = std::min<uint16_t>(left, I2S_DESC_MAX);
+                desc->blocksize = desc->datalen = len;
+                desc->owner = 1;
+                desc->eof = 0;
+                desc->buf_ptr = buf;
+                buf += len;
+                left -= len;
+                if (!left) break;
+                desc->next = desc + 1;
+                desc++;
+            }
+            desc->next = &i2s_idle;
+            desc->eof = 1;
+            i2sDesc->eof = 1;
+
+            i2s_first = i2sDesc;
+            i2s_last = desc;
+            i2s_busy = true;
+            i2s_idle.next = i2sDesc;
+        }
 
     } else if (type == PixelType::GECE) {
-        uint32_t packet = 0;
-        uint32_t pTime = 0;
+        /*
+        * Every packet is encoded up front, handleGECE() feeds them out on
+        * timer1 so show() doesn't block for the ~835us each bulb takes.
+        * What goes on the wire is as before: the same 26 bit packets, start
+        * bit and spacing, only the fields are masked in directly. Bulbs are
+        * mapped like the other types (grouping, zigzag, virtual strings and
+        * blending), but take the top 4 bits of each color as is, no gamma,
+        * and have no power estimate. begin() keeps GECE to RGB and
+        * GECE_BULBS, so the stride is 3 and the address fits its 6 bits.
+        */
+        uint8_t *out = asyncdata;
+        const pixel_run_t *run = runs;
+        for (uint16_t led = 0; led < count; led++) {
+            while (led == run->end)
+                run++;
+            uint16_t offset = pixmap ? pixmap[led] : chPixel * led;
+            const uint8_t *pixel = src + offset;
+            uint8_t rgb[3];
+            for (uint8_t ch = 0; ch < 3; ch++) {
+                uint8_t srcCh = run->order[ch];
+                uint8_t in = pixel[srcCh];
+                if (blend < 256)
+                    in = lerp(prevdata[offset + srcCh], in, blend);
+                if (run->scale < 256)
+                    in = (in * run->scale) >> 8;
+                rgb[ch] = in;
+            }
+            uint32_t packet = (static_cast<uint32_t>(led) << 20) |
+                    (GECE_DEFAULT_BRIGHTNESS << 12) |
+                    ((rgb[2] << 4) & GECE_BLUE_MASK) |
+                    (rgb[1] & GECE_GREEN_MASK) | (rgb[0] >> 4);
+            out = encodeGECE(out, packet);
+        }
+
+        uart_buffer[UART] = asyncdata;
+        uart_buffer_tail[UART] = out;
 
-        // Build a GECE packet
         startTime = micros();
-        for (uint8_t i = 0; i < numPixels; i++) {
-            packet = (packet & ~GECE_ADDRESS_MASK) | (i << 20);
-            packet = (packet & ~GECE_BRIGHTNESS_MASK) |
-                    (GECE_DEFAULT_BRIGHTNESS << 12);
-            packet = (packet & ~GECE_BLUE_MASK) | (pixdata[i*3+2] << 4);
-            packet = (packet & ~GECE_GREEN_MASK) | pixdata[i*3+1];
-            packet = (packet & ~GECE_RED_MASK) | (pixdata[i*3] >> 4);
-
-            uint8_t shift = GECE_PSIZE;
-            for (uint8_t i = 0; i < GECE_PSIZE; i++)
-                pbuff[i] = LOOKUP_GECE[(packet >> --shift) & 0x1];
-
-            // Wait until ready
-            while ((micros() - pTime) < (GECE_TFRAME + GECE_TIDLE)) {}
-
-            // 10us start bit
-            pTime = micros();
-            uint32_t c = _getCycleCount();
-            CLEAR_PERI_REG_MASK(UART_CONF0(UART), UART_TXD_BRK);
-            while ((_getCycleCount() - c) < CYCLES_GECE_START - 100) {}
-
-            // Send packet and idle low (break)
-            Serial1.write(pbuff, GECE_PSIZE);
-            SET_PERI_REG_MASK(UART_CONF0(UART), UART_TXD_BRK);
+        txTime = (GECE_TFRAME + GECE_TIDLE) * count;
+        gece_packet = false;
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+        handleGECE();
+
+    } else if (isClocked(type)) {
+        /*
+        * APA102 frames start with 32 zero bits and prefix each pixel with
+        * its global brightness. LPD8806 takes 7 bits per color with the MSB
+        * set. Both need a zero bit per two (APA102) or 32 (LPD8806) pixels
+        * on the end to clock the data through. WS2801 is raw bytes and
+        * latches after 500us idle.
+        */
+        uint8_t mask = type == PixelType::LPD8806 ? 0x80 : 0x00;
+        uint8_t shift = type == PixelType::LPD8806 ? 1 : 0;
+        bool header = type == PixelType::APA102;
+
+        uint8_t *out = asyncdata;
+        uint8_t *err = ditherErr;
+        if (header) {
+            memset(out, 0, 4);
+            out += 4;
         }
+        const pixel_run_t *run = runs;
+        for (size_t led = 0; led < count; led++) {
+            while (led == run->end)
+                run++;
+            uint16_t offset = pixmap ? pixmap[led] : chPixel * led;
+            const uint8_t *pixel = src + offset;
+            if (header)
+                *out++ = 0xE0 | globalBrite;
+            for (uint8_t ch = 0; ch < chPixel; ch++) {
+                uint8_t srcCh = run->order[ch];
+                uint8_t in = pixel[srcCh];
+                if (blend < 256)
+                    in = lerp(prevdata[offset + srcCh], in, blend);
+                if (run->scale < 256)
+                    in = (in * run->scale) >> 8;
+                uint8_t val = err ? dither(GAMMA_TABLE16[srcCh], in, *err++)
+                                  : GAMMA_TABLE[srcCh][in];
+                level += val;
+                if (scale < 256)
+                    val = (val * scale) >> 8;
+                *out++ = mask | (val >> shift);
+            }
+        }
+        uint16_t latch = 0;
+        if (type == PixelType::APA102)
+            latch = (count + 15) / 16;
+        else if (type == PixelType::LPD8806)
+            latch = (count + 31) / 32;
+        memset(out, 0, latch);
+        out += latch;
+
+        /*
+        * SPI.writeBytes() blocks until its bytes are out, so APA102 and
+        * LPD8806 go out SPI_CHUNK bytes per service(), at most 2ms a pass
+        * (LPD8806 at 2MHz). They latch on the trailing clocks and don't
+        * care about gaps. WS2801 latches after 500us idle, so it has to go
+        * in one write: 8us a byte at 1MHz, ~33ms for 1360 pixels. Its frame
+        * time is WS2801_DUTY times that, so the loop gets at least half
+        * the time.
+        */
+        uint16_t len = out - asyncdata;
+        uint32_t clock = APA102_CLOCK;
+        if (type == PixelType::WS2801)
+            clock = WS2801_CLOCK;
+        else if (type == PixelType::LPD8806)
+            clock = LPD8806_CLOCK;
+        startTime = micros();
+        txTime = len * 8UL / (clock / 1000000L) + 1;
+        if (type == PixelType::WS2801)
+            txTime = (txTime - 1) * WS2801_DUTY + WS2801_TIDLE;
+        spiPos = asyncdata;
+        spiEnd = out;
+        writeSPI();
+
+        /* APA102 global brightness scales the current too */
+        if (header)
+            level = level * globalBrite / 31;
     }
+
+    if (count == numPixels && type != PixelType::GECE)
+        updatePower(level);
+}
+
+/*
+* Bulk ingest for whole universes. The last changed byte is all the dirty
+* tracking needs, so the comparison scans back from the end and the copy
+* goes in one pass.
+*/
+void PixelDriver::setValues(uint16_t address, const uint8_t *src,
+        uint16_t len) {
+    if (address >= szBuffer)
+        return;
+    if (len > szBuffer - address)
+        len = szBuffer - address;
+
+    uint8_t *dst = pixdata + address;
+    uint16_t changed = len;
+    while (changed && dst[changed - 1] == src[changed - 1])
+        changed--;
+    if (!changed)
+        return;
+
+    memcpy(dst, src, changed);
+    fresh = true;
+    if (address + changed > szDirty)
+        szDirty = address + changed;
 }
 
 uint8_t* PixelDriver::getData() {
-    return asyncdata;	// data post grouping or zigzaging
-//    return pixdata;
+    return pixdata;     // asyncdata holds encoded UART symbols
 }
@@ -23,8 +23,7 @@
 #define UART_INV_MASK  (0x3f << 19)
 #define UART 1
 
-/* Gamma correction table */
-extern uint8_t GAMMA_TABLE[];
+#include "gamma.h"
 
 /* 
 * Inverted 6N1 UART lookup table for ws2811, first 2 bits ignored.
@@ -37,6 +36,22 @@ const char LOOKUP_2811[4] = {
     0b00000100      // 11 - (1)110 111(0)
 };
 
+/*
+* Inverted 7N1 UART lookup table for ws2811, 3 data bits per symbol with
+* the MSB out first. Start and stop bits are part of the pixel stream, each
+* data bit is 3 UART bits: 100 for 0, 110 for 1.
+*/
+const char LOOKUP_2811_7N1[8] = {
+    0b01011011,     // 000 - (1)00 100 10(0)
+    0b00011011,     // 001 - (1)00 100 11(0)
+    0b01010011,     // 010 - (1)00 110 10(0)
+    0b00010011,     // 011 - (1)00 110 11(0)
+    0b01011010,     // 100 - (1)10 100 10(0)
+    0b00011010,     // 101 - (1)10 100 11(0)
+    0b01010010,     // 110 - (1)10 110 10(0)
+    0b00010010      // 111 - (1)10 110 11(0)
+};
+
 /* 
 * 7N1 UART lookup table for GECE, first bit is ignored.
 * Start bit and stop bits are part of the packet.
@@ -48,7 +63,22 @@ const char LOOKUP_GECE[2] = {
     0b01100000      // 1 - (0)00 000 11(1)
 };
 
+#define WS2811_SYMBOLS  4       /* UART symbols per WS2811 subpixel */
+
+/*
+* I2S bit patterns for a nibble at 4x 800KHz, one WS2811 bit per 4 I2S bits:
+* 0 is 1000 (312ns high), 1 is 1110 (937ns high). MSB first.
+*/
+const uint16_t LOOKUP_I2S[16] = {
+    0x8888, 0x888E, 0x88E8, 0x88EE, 0x8E88, 0x8E8E, 0x8EE8, 0x8EEE,
+    0xE888, 0xE88E, 0xE8E8, 0xE8EE, 0xEE88, 0xEE8E, 0xEEE8, 0xEEEE
+};
+
+#define I2S_DESC_MAX    4092    /* Max bytes per SLC DMA descriptor, word aligned */
+#define I2S_IDLE_SIZE   128     /* Zero bytes the DMA loops on between frames */
+
 #define GECE_DEFAULT_BRIGHTNESS 0xCC
+#define GECE_BULBS              63      /* Addresses a packet can carry */
 
 #define GECE_ADDRESS_MASK       0x03F00000
 #define GECE_BRIGHTNESS_MASK    0x000FF000
@@ -64,18 +94,55 @@ const char LOOKUP_GECE[2] = {
 #define GECE_PSIZE                  26
 
 #define WS2811_TFRAME   30L     /* 30us frame time */
+#define WS2811_7N1_BAUD 2666667 /* 80MHz / 30, 375ns per UART bit */
+#define WS2811_7N1_TFRAME   27L /* 27us frame time at WS2811_7N1_BAUD */
 #define WS2811_TIDLE    300L    /* 300us idle time */
 #define GECE_TFRAME     790L    /* 790us frame time */
 #define GECE_TIDLE      45L     /* 45us idle time - should be 30us */
 
-#define CYCLES_GECE_START   (F_CPU / 100000) // 10us
+#define GECE_TSTART     10L     /* 10us start bit */
+
+/* Clocked pixels on the hardware SPI - MOSI GPIO13, SCK GPIO14 */
+#define APA102_CLOCK    8000000L    /* 8MHz */
+#define WS2801_CLOCK    1000000L    /* 1MHz */
+#define LPD8806_CLOCK   2000000L    /* 2MHz */
+#define WS2801_TIDLE    500L        /* 500us latch time */
+#define SPI_CHUNK       512         /* Bytes written per service(), APA102 / LPD8806 */
+#define WS2801_DUTY     2           /* Min frame time / SPI write time, WS2801 */
+
+#define POWER_CHANNEL_MA    20  /* Default mA drawn by a channel at full */
+#define POWER_RAMP          4   /* Limiter recovery per frame, in 1/256 */
+
+#define PIXEL_SEGMENTS  8       /* Virtual strings per output */
+
+#define INTERP_MAX      100000L /* Input frames further apart than this aren't blended */
+#define INTERP_CUT      96      /* Level change that counts as a jump */
+
+/* timer1 runs at 80MHz / 16, 5 ticks per microsecond */
+#define GECE_TICKS(us)  ((us) * 5)
 
 /* Pixel Types */
 enum class PixelType : uint8_t {
     WS2811,
-    GECE
+    GECE,
+    APA102,
+    WS2801,
+    LPD8806,
+    WS2811_I2S,
+    WS2811_7N1
 };
 
+/* True for pixel types that speak the WS2811 protocol, whatever drives them */
+inline bool isWS2811(PixelType type) {
+    return type == PixelType::WS2811 || type == PixelType::WS2811_I2S ||
+            type == PixelType::WS2811_7N1;
+}
+
+/* True for pixel types driven from the hardware SPI */
+inline bool isClocked(PixelType type) {
+    return type >= PixelType::APA102 && type <= PixelType::LPD8806;
+}
+
 /* Color Order */
 enum class PixelColor : uint8_t {
     RGB,
@@ -83,11 +150,67 @@ enum class PixelColor : uint8_t {
     BRG,
     RBG,
     GBR,
-    BGR
+    BGR,
+    RGBW,
+    GRBW,
+    BRGW,
+    RBGW,
+    GBRW,
+    BGRW
 };
 
+/* Channels per pixel for a color order, W orders add a white channel */
+inline uint8_t pixelChannels(PixelColor color) {
+    return color >= PixelColor::RGBW ? 4 : 3;
+}
+
+/*
+* Virtual string, a run of pixels on the output with its own source
+* channels and layout. The string's channel count comes from the driver,
+* the color order only picks which source channel goes out where.
+*/
+typedef struct {
+    uint16_t    start;          /* First source channel, 0 based */
+    uint16_t    count;          /* Pixels, not counting nulls */
+    uint8_t     nulls;          /* Dark pixels ahead of the segment */
+    uint8_t     group;          /* Output pixels per source pixel */
+    bool        reverse;        /* Last source pixel goes out first */
+    PixelColor  color;          /* Color order */
+    uint8_t     brightness;     /* 0 - 100, on top of the gamma table brightness */
+} pixel_segment_t;
+
+/*
+* Pixels needed to hold a segment layout, enough to cover both the output
+* pixels and the source channels it reads.
+*/
+uint16_t segmentLength(const pixel_segment_t *segments, uint8_t count,
+        uint8_t chPixel);
+
+struct i2s_desc;
+
+/* Stretch of output pixels sharing a channel order and scale */
+typedef struct {
+    uint16_t        end;        /* First output pixel past the run */
+    uint16_t        scale;      /* Input scale in 1/256, 0 for null pixels */
+    const uint8_t   *order;     /* Source channel of each output byte */
+} pixel_run_t;
+
+/* Output governor statistics */
+typedef struct {
+    uint32_t presented;     /* Frames sent to the string */
+    uint32_t coalesced;     /* Frames replaced by a newer one before going out */
+    uint32_t late;          /* Frames that had to wait for the string */
+    uint32_t current;       /* Estimated mA of the last full frame, before limiting */
+    uint32_t peak;          /* Highest estimate since begin() */
+} pixel_stats_t;
+
 class PixelDriver {
  public:
+    pixel_stats_t stats;    // Output statistics
+
+    /* WS2811 strings go out on UART1 (GPIO2) or UART0 (GPIO1) */
+    explicit PixelDriver(uint8_t uart = UART) : uart(uart) {}
+
     int begin();
     int begin(PixelType type);
     int begin(PixelType type, PixelColor color, uint16_t length);
@@ -96,66 +219,235 @@ class PixelDriver {
     void ICACHE_RAM_ATTR show();
     uint8_t* getData();
 
-    /* Set channel value at address */
+    /*
+    * Mark the data written so far as a complete frame. smooth = false keeps
+    * it from being interpolated, for sources that change abruptly. Safe to
+    * call from network callbacks: one landing while service() is encoding
+    * nextdata (it yielded) is held until service() is done with it.
+    */
+    void commit(bool smooth = true);
+
+    /* Send the newest complete frame once the string and frame rate allow */
+    void service();
+
+    /* Cap the output frame rate, 0 = as fast as the string allows */
+    void setTargetFps(uint8_t fps);
+
+    /*
+    * Move what we can of briteVal into the APA102 5 bit global brightness.
+    * Returns the brightness the gamma table still has to apply.
+    */
+    float setBrightness(float briteVal);
+
+    /*
+    * Scale the output down when a frame would draw more than budget mA,
+    * 0 = no limit. channelMa is what a channel draws at full.
+    */
+    void setPowerLimit(uint16_t budget, uint8_t channelMa);
+
+    /* Power limiter scale, 256 when not limiting */
+    inline uint16_t getPowerScale() {
+        return powerScale;
+    }
+
+    /* Highest frame rate the string can take */
+    inline uint16_t getMaxFps() {
+        return refreshTime ? 1000000UL / refreshTime : 0;
+    }
+
+    /* Channels per pixel for the current color order */
+    inline uint8_t getChannels() {
+        return chPixel;
+    }
+
+    /* Set channel value at address, tracking how far the frame changed */
     inline void setValue(uint16_t address, uint8_t value) {
-        pixdata[address] = value;
+        if (pixdata[address] != value) {
+            pixdata[address] = value;
+            fresh = true;
+            if (address >= szDirty)
+                szDirty = address + 1;
+        }
     }
 
+    /* Set len values from address on in one pass, same rules as setValue() */
+    void setValues(uint16_t address, const uint8_t *src, uint16_t len);
+
     /* Set group / zigzag counts */
-    inline void setGroup(uint16_t _group, uint16_t _zigzag) {
-        this->cntGroup = _group;
-        this->cntZigzag = _zigzag;
+    void setGroup(uint16_t _group, uint16_t _zigzag);
+
+    /*
+    * Lay the output out as virtual strings, in order along the string.
+    * Replaces group / zigzag, count = 0 goes back to them.
+    */
+    void setSegments(const pixel_segment_t *segments, uint8_t count);
+
+    /* Dither the 16 bit gamma table down to 8 bits across frames */
+    void setDither(bool dither);
+
+    /* Blend between input frames at the string's refresh rate */
+    void setInterpolate(bool interpolate);
+
+    /* Resend the whole string at least every ms milliseconds, 0 = always */
+    inline void setFullRefresh(uint16_t ms) {
+        fullRefresh = ms;
     }
 
     /* Drop the update if our refresh rate is too high */
     inline bool canRefresh() {
-        return (micros() - startTime) >= refreshTime;
+        return (micros() - startTime) >= std::max(txTime, frameInterval);
+    }
+
+    /* True while the ISR is still sending the encoded frame */
+    bool isBusy();
+
+    /*
+    * Expand a corrected subpixel into the I2S waveform, 4 bytes per subpixel.
+    * The DMA sends each 32 bit word MSB first, so the low nibble goes in the
+    * lower half-word. Has no hardware dependencies.
+    */
+    static inline uint16_t* encodeI2S(uint16_t *out, uint8_t val) {
+        *out++ = LOOKUP_I2S[val & 0xF];
+        *out++ = LOOKUP_I2S[val >> 4];
+        return out;
     }
 
  private:
     PixelType   type;           // Pixel type
+    uint8_t     uart;           // UART for WS2811 output
     PixelColor  color;          // Color Order
     uint16_t    cntGroup;       // Output modifying interval (in LEDs, not channels)
     uint16_t    cntZigzag;      // Zigzag every cntZigzag physical pixels
     uint8_t     pin;            // Pin for bit-banging
-    uint8_t     *pixdata;       // Pixel buffer
-    uint8_t     *asyncdata;     // Async buffer
-    uint8_t     *pbuff;         // GECE Packet Buffer
+    uint8_t     *pixdata;       // Pixel buffer, written by receivers
+    uint8_t     *asyncdata;     // Async buffer, encoded frame owned by the ISR
+    uint16_t    *pixmap;        // Source offset of each output pixel, NULL if 1:1
+    uint8_t     *ditherErr;     // Residue of each output subpixel, NULL if not dithering
+    uint8_t     *nextdata;      // Last committed frame, what show() sends
+    uint8_t     *prevdata;      // Frame the blend starts from, NULL if not interpolating
     uint16_t    numPixels;      // Number of pixels
     uint16_t    szBuffer;       // Size of Pixel buffer
+    uint16_t    szAsync;        // Size of Async buffer
+    uint16_t    szDirty;        // Channels up to the last one changed, 0 if none
+    uint16_t    szCommit;       // Same for nextdata since it was last sent
+    uint16_t    fullRefresh;    // Max ms between full frames
+    uint32_t    fullTime;       // When the last full frame TX started, in millis
     uint32_t    startTime;      // When the last frame TX started
-    uint32_t    refreshTime;    // Time until we can refresh after starting a TX
-    static uint8_t    rOffset;  // Index of red byte
-    static uint8_t    gOffset;  // Index of green byte
-    static uint8_t    bOffset;  // Index of blue byte
+    uint32_t    refreshTime;    // Time to TX a full frame
+    uint32_t    txTime;         // Time until we can refresh after starting the last TX
+    uint32_t    frameInterval;  // Min time between frames for the target rate
+    uint32_t    commitTime;     // When the last frame was committed
+    uint32_t    blendTime;      // Time to blend into nextdata, 0 to show it as is
+    bool        fresh;          // Data changed since the last commit()
+    bool        pending;        // A committed frame is waiting to go out
+    bool        servicing;      // service() is reading nextdata
+    bool        deferred;       // commit() came in during service(), smooth
+    bool        deferSmooth;    //   is what it asked for
+    uint8_t     chPixel;        // Channels per pixel, 3 or 4
+    uint8_t     chOffset[4];    // Source channel of each output byte
+    pixel_segment_t segments[PIXEL_SEGMENTS];   // Virtual strings
+    uint8_t     cntSegments;    // Virtual strings in use, 0 for group / zigzag
+    uint8_t     segOrder[PIXEL_SEGMENTS][4];    // chOffset of each virtual string
+    pixel_run_t runs[PIXEL_SEGMENTS * 2 + 1];   // Output runs, last one ends at numPixels
+    uint8_t     globalBrite;    // APA102 global brightness, 0 - 31
+    const uint8_t *spiPos;      // Rest of the clocked frame still to write
+    const uint8_t *spiEnd;
+    uint16_t    powerBudget;    // Supply budget in mA, 0 if not limiting
+    uint8_t     channelMa;      // mA per channel at full
+    uint16_t    powerScale;     // Output scale applied by the limiter, 1/256
+    uint16_t    powerTarget;    // Scale the limiter is heading for
+    i2s_desc    *i2sDesc;       // SLC DMA descriptors over asyncdata
 
     void ws2811_init();
     void gece_init();
+    void spi_init();
+    void i2s_init();
+    void i2s_stop();
+    void updateMap();
+    void updateSegments();
+    void updatePower(uint32_t level);
+
+    /* Write the next chunk of a clocked frame */
+    void writeSPI();
+    void snapshot(bool smooth);
+
+    /* Source channel of each output byte for a color order */
+    static void colorOffsets(PixelColor color, uint8_t *offset);
+
+    /* Position of the blend between prevdata and nextdata, 0 - 256 */
+    inline uint16_t blendPos() {
+        uint32_t elapsed = micros() - commitTime;
+        return elapsed >= blendTime ? 256 : elapsed * 256 / blendTime;
+    }
+
+    /* Fixed point blend of two levels, t in 1/256 */
+    static inline uint8_t lerp(uint8_t from, uint8_t to, uint16_t t) {
+        return from + (((to - from) * t) >> 8);
+    }
+
+    /* Gamma correct a subpixel, carrying what 8 bits can't show to the next frame */
+    static inline uint8_t dither(const uint16_t *table, uint8_t subpix,
+            uint8_t &err) {
+        uint16_t val = table[subpix] + err;
+        err = val & 0xFF;
+        return val >> 8;
+    }
+
+    /* Encode a corrected subpixel into UART symbols */
+    static inline uint8_t* encodeWS2811(uint8_t *out, uint8_t val) {
+        *out++ = LOOKUP_2811[(val >> 6) & 0x3];
+        *out++ = LOOKUP_2811[(val >> 4) & 0x3];
+        *out++ = LOOKUP_2811[(val >> 2) & 0x3];
+        *out++ = LOOKUP_2811[val & 0x3];
+        return out;
+    }
+
+    /*
+    * Encode a corrected subpixel into 7N1 symbols. Symbols carry 3 bits and
+    * subpixels 8, so acc / bits carry the remainder to the next call.
+    */
+    static inline uint8_t* encodeWS2811_7N1(uint8_t *out, uint8_t val,
+            uint16_t &acc, uint8_t &bits) {
+        acc = (acc << 8) | val;
+        bits += 8;
+        while (bits >= 3) {
+            bits -= 3;
+            *out++ = LOOKUP_2811_7N1[(acc >> bits) & 0x7];
+        }
+        return out;
+    }
+
+    /* Encode a 26 bit GECE packet into UART symbols, MSB first */
+    static inline uint8_t* encodeGECE(uint8_t *out, uint32_t packet) {
+        *out++ = LOOKUP_GECE[(packet >> 25) & 0x1];
+        *out++ = LOOKUP_GECE[(packet >> 24) & 0x1];
+        for (int8_t shift = 20; shift >= 0; shift -= 4) {
+            memcpy(out, gece_nibble[(packet >> shift) & 0xF], 4);
+            out += 4;
+        }
+        return out;
+    }
+
+    static uint8_t gece_nibble[16][4];  // LOOKUP_GECE expanded per nibble
 
     /* FIFO Handlers */
-    static const uint8_t* ICACHE_RAM_ATTR fillWS2811(const uint8_t *buff,
-            const uint8_t *tail);
+    static const uint8_t* ICACHE_RAM_ATTR fillWS2811(uint8_t uart,
+            const uint8_t *buff, const uint8_t *tail);
 
     /* Interrupt Handlers */
     static void ICACHE_RAM_ATTR handleWS2811(void *param);
+    static void ICACHE_RAM_ATTR handleGECE();
+    static void ICACHE_RAM_ATTR handleI2S(void *param);
 
-    /* Returns number of bytes waiting in the TX FIFO of UART1 */
-    static inline uint8_t getFifoLength() {
-        return (U1S >> USTXC) & 0xff;
+    /* Returns number of bytes waiting in the TX FIFO of a UART */
+    static inline uint8_t getFifoLength(uint8_t uart) {
+        return (USS(uart) >> USTXC) & 0xff;
     }
 
-    /* Append a byte to the TX FIFO of UART1 */
-    static inline void enqueue(uint8_t byte) {
-        U1F = byte;
+    /* Append a byte to the TX FIFO of a UART */
+    static inline void enqueue(uint8_t uart, uint8_t byte) {
+        USF(uart) = byte;
     }
 };
 
-// Cycle counter
-static uint32_t _getCycleCount(void) __attribute__((always_inline));
-static inline uint32_t _getCycleCount(void) {
-    uint32_t ccount;
-    __asm__ __volatile__("rsr %0,ccount":"=a" (ccount));
-    return ccount;
-}
-
 #endif /* PIXELDRIVER_H_ */
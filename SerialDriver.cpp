@@ -35,9 +35,18 @@ extern "C" {
 #include <uart_register.h>
 }
 
-/* Uart Buffer tracker */
-static const uint8_t *uart_buffer;
-static const uint8_t *uart_buffer_tail;
+/* DMX line state of each UART, stepped by handleBreak() */
+enum : uint8_t { DMX_IDLE, DMX_IN_BREAK, DMX_IN_MAB };
+
+/* Uart Buffer tracker, per UART */
+static const uint8_t *uart_buffer[2];
+static const uint8_t *uart_buffer_tail[2];
+static volatile uint8_t dmx_phase[2];   // Where each UART is in its break
+static uint32_t dmx_due[2];             // micros() the current phase ends at
+static uint16_t dmx_mab_time[2];        // MAB length once the break ends
+
+uint8_t SerialDriver::renard_escape[256];
+uint8_t SerialDriver::curve_table[SERIAL_CURVES][256];
 
 int SerialDriver::begin(HardwareSerial *theSerial, SerialType type,
         uint16_t length) {
@@ -48,6 +57,14 @@ int SerialDriver::begin(HardwareSerial *theSerial, SerialType type,
         uint16_t length, BaudRate baud) {
     int retval = true;
 
+    /* Drop a break in progress before the buffers go away */
+    dmx_phase[_uart] = DMX_IDLE;
+
+    /* Profiles are sized for the old buffer, setProfiles() again after */
+    setProfiles(nullptr, 0);
+    if (!curve_table[static_cast<uint8_t>(SerialCurve::LINEAR)][255])
+        buildCurves();
+
     _type = type;
     _serial = theSerial;
     _size = length;
@@ -56,62 +73,87 @@ int SerialDriver::begin(HardwareSerial *theSerial, SerialType type,
     /* frameTime = szSymbol * 1000000 / baud * szBuffer */
     if (type == SerialType::RENARD) {
         _size = length + 2;
-        /* 10 bit symbols, no idle */
-        frameTime = ceil(10.0 * 1000000.0
-                / static_cast<float>(baud)
-                * static_cast<float>(_size));
+        /* 10 bit symbols, no idle. show() updates this for escapes */
+        _byteTime = 10.0 * 1000000.0 / static_cast<float>(baud);
+        _overhead = 0;
+        frameTime = ceil(_byteTime * static_cast<float>(_size));
         _serial->begin(static_cast<uint32_t>(baud));
+
+        for (uint16_t i = RENARD_PAD; i <= RENARD_ESC; i++)
+            renard_escape[i] = i - RENARD_ESC_OFFSET;
     } else if (type == SerialType::DMX512) {
         _size = length + 1;
         /* 11 bit symbols, add BREAK and MAB */
-        frameTime = ceil(11.0 * 1000000.0
-                / static_cast<float>(BaudRate::BR_250000)
-                * static_cast<float>(_size)
-                + static_cast<float>(DMX_BREAK)
-                + static_cast<float>(DMX_MAB));
+        _byteTime = 11.0 * 1000000.0
+                / static_cast<float>(BaudRate::BR_250000);
+        setBreak(_break, _mab);
         _serial->begin(static_cast<uint32_t>(BaudRate::BR_250000), SERIAL_8N2);
+
+        /* Break and MAB are timed by timer1, one shot each */
+        timer1_isr_init();
+        timer1_attachInterrupt(handleBreak);
     } else {
         retval = false;
     }
 
     /* Setup buffers */
     if (_serialdata) free(_serialdata);
-    if (_serialdata = static_cast<uint8_t *>(malloc(_size))) {
+    if (_framedata) free(_framedata);
+    _serialdata = static_cast<uint8_t *>(malloc(_size));
+    _framedata = static_cast<uint8_t *>(malloc(_size));
+    if (_serialdata && _framedata) {
         memset(_serialdata, 0, _size);
+        memset(_framedata, 0, _size);
     } else {
         _size = 0;
         retval = false;
     }
 
+    /* Every Renard channel could need an escape */
+    uint16_t szAsync = _size;
+    if (type == SerialType::RENARD)
+        szAsync = _size * 2 - 2;
+
     if (_asyncdata) free(_asyncdata);
-    if (_asyncdata = static_cast<uint8_t *>(malloc(_size)))
-        memset(_asyncdata, 0, _size);
+    _asyncdata = static_cast<uint8_t *>(malloc(szAsync));
+    if (_asyncdata)
+        memset(_asyncdata, 0, szAsync);
     else
         retval = false;
 
-    if (_serialdata && type == SerialType::RENARD) {
-        _serialdata[0] = 0x7E;
-        _serialdata[1] = 0x80;
+    /* Renard header, the other buffers keep the slots so offsets line up */
+    if (retval && type == SerialType::RENARD) {
+        _serialdata[0] = _framedata[0] = _asyncdata[0] = RENARD_SYNC;
+        _serialdata[1] = _framedata[1] = _asyncdata[1] = RENARD_ADDR;
     }
+    _dirty = 0;
+    _frameStale = 0;
+    _asyncStale = _size;
+    txTime = frameTime;
+
+    memset(&stats, 0, sizeof(stats));
+    _fresh = false;
+    _pending = true;    // The cleared frame
 
     /* Clear FIFOs */
-    SET_PERI_REG_MASK(UART_CONF0(SEROUT_UART), UART_RXFIFO_RST | UART_TXFIFO_RST);
-    CLEAR_PERI_REG_MASK(UART_CONF0(SEROUT_UART), UART_RXFIFO_RST | UART_TXFIFO_RST);
+    SET_PERI_REG_MASK(UART_CONF0(_uart), UART_RXFIFO_RST | UART_TXFIFO_RST);
+    CLEAR_PERI_REG_MASK(UART_CONF0(_uart), UART_RXFIFO_RST | UART_TXFIFO_RST);
 
     /* Disable all interrupts */
     ETS_UART_INTR_DISABLE();
+    uart_buffer[_uart] = uart_buffer_tail[_uart] = nullptr;
 
-    /* Atttach interrupt handler */
+    /* Atttach interrupt handler, the same one serves both UARTs */
     ETS_UART_INTR_ATTACH(serial_handle, NULL);
 
     /* Set TX FIFO trigger. 80 bytes gives 200 microsecs to refill the FIFO */
-    WRITE_PERI_REG(UART_CONF1(SEROUT_UART), 80 << UART_TXFIFO_EMPTY_THRHD_S);
+    WRITE_PERI_REG(UART_CONF1(_uart), 80 << UART_TXFIFO_EMPTY_THRHD_S);
 
     /* Disable RX & TX interrupts. It is enabled by uart.c in the SDK */
-    CLEAR_PERI_REG_MASK(UART_INT_ENA(SEROUT_UART), UART_RXFIFO_FULL_INT_ENA | UART_TXFIFO_EMPTY_INT_ENA);
+    CLEAR_PERI_REG_MASK(UART_INT_ENA(_uart), UART_RXFIFO_FULL_INT_ENA | UART_TXFIFO_EMPTY_INT_ENA);
 
-    /* Clear all pending interrupts in SEROUT_UART */
-    WRITE_PERI_REG(UART_INT_CLR(SEROUT_UART), 0xffff);
+    /* Clear all pending interrupts in our UART */
+    WRITE_PERI_REG(UART_INT_CLR(_uart), 0xffff);
 
     /* Reenable interrupts */
     ETS_UART_INTR_ENABLE();
@@ -119,64 +161,415 @@ int SerialDriver::begin(HardwareSerial *theSerial, SerialType type,
     return retval;
 }
 
-const uint8_t* ICACHE_RAM_ATTR SerialDriver::fillFifo(const uint8_t *buff, const uint8_t *tail) {
-    uint8_t avail = (UART_TX_FIFO_SIZE - getFifoLength());
+const uint8_t* ICACHE_RAM_ATTR SerialDriver::fillFifo(uint8_t uart,
+        const uint8_t *buff, const uint8_t *tail) {
+    uint8_t avail = (UART_TX_FIFO_SIZE - getFifoLength(uart));
     if (tail - buff > avail)
         tail = buff + avail;
 
     while (buff < tail)
-        enqueue(*buff++);
+        enqueue(uart, *buff++);
 
     return buff;
 }
 
+/* Refill whichever UARTs have a frame going out, just clear the others */
 void ICACHE_RAM_ATTR SerialDriver::serial_handle(void *param) {
-    /* Process and clear SEROUT_UART */
-    if (READ_PERI_REG(UART_INT_ST(SEROUT_UART))) {
-        // Fill the FIFO with new data
-        uart_buffer = fillFifo(uart_buffer, uart_buffer_tail);
+    for (uint8_t u = UART0; u <= UART1; u++) {
+        if (!READ_PERI_REG(UART_INT_ST(u)))
+            continue;
+
+        if (uart_buffer[u] && dmx_phase[u] == DMX_IDLE) {
+            // Fill the FIFO with new data
+            uart_buffer[u] = fillFifo(u, uart_buffer[u], uart_buffer_tail[u]);
 
-        // Clear TX interrupt when done
-        if (uart_buffer == uart_buffer_tail)
-            CLEAR_PERI_REG_MASK(UART_INT_ENA(SEROUT_UART), UART_TXFIFO_EMPTY_INT_ENA);
+            // Clear TX interrupt when done
+            if (uart_buffer[u] == uart_buffer_tail[u])
+                CLEAR_PERI_REG_MASK(UART_INT_ENA(u), UART_TXFIFO_EMPTY_INT_ENA);
+        }
 
         // Clear all interrupts flags (just in case)
-        WRITE_PERI_REG(UART_INT_CLR(SEROUT_UART), 0xffff);
+        WRITE_PERI_REG(UART_INT_CLR(u), 0xffff);
+    }
+}
+
+
+/*
+* Bulk ingest for whole universes. Only the last changed byte matters for
+* the short frame, so the comparison scans back from the end until it
+* finds it and the copy goes in one pass.
+*/
+void SerialDriver::setValues(uint16_t address, const uint8_t *src, uint16_t len) {
+    if (_profile) {
+        if (address >= _channels)
+            return;
+        len = std::min<uint16_t>(len, _channels - address);
+        while (len--)
+            setLevel(address++, *src++);
+        return;
+    }
+
+    uint8_t *dst;
+    if (_type == SerialType::RENARD)
+        dst = _serialdata + address + 2;
+    else if (_type == SerialType::DMX512)
+        dst = _serialdata + address + 1;
+    else
+        return;
+
+    if (dst + len > _serialdata + _size)
+        len = _serialdata + _size > dst ? _serialdata + _size - dst : 0;
+
+    uint16_t changed = len;
+    while (changed && dst[changed - 1] == src[changed - 1])
+        changed--;
+    if (!changed)
+        return;
+
+    memcpy(dst, src, changed);
+    markDirty(dst - _serialdata + changed);
+}
+
+/*
+* Renard reserves 0x7D - 0x7F for pad, sync and escape. Those values go out
+* as RENARD_ESC and value - 0x4E, everything else as is, so the table
+* lookup replaces a compare chain per channel.
+*/
+uint16_t SerialDriver::encodeRenard(uint16_t len) {
+    const uint8_t *in = _framedata + 2;
+    const uint8_t *end = _framedata + len;
+    uint8_t *out = _asyncdata + 2;
+
+    while (in < end) {
+        uint8_t value = *in++;
+        uint8_t esc = renard_escape[value];
+        if (esc) {
+            *out++ = RENARD_ESC;
+            *out++ = esc;
+        } else {
+            *out++ = value;
+        }
+    }
+    return out - _asyncdata;
+}
+
+/*
+* The UART holds the line low while TXD_BRK is set. timer1 ends the break,
+* then the MAB, and hands the frame to the TX FIFO interrupt, so show()
+* doesn't have to wait either out. Both UARTs share the timer, so each
+* call steps whichever is due and re-arms for the nearest deadline.
+*/
+void ICACHE_RAM_ATTR SerialDriver::handleBreak() {
+    uint32_t now = micros();
+    uint32_t next = UINT32_MAX;
+    for (uint8_t u = UART0; u <= UART1; u++) {
+        bool due = static_cast<int32_t>(now - dmx_due[u]) >= 0;
+        if (dmx_phase[u] == DMX_IN_BREAK && due) {
+            CLEAR_PERI_REG_MASK(UART_CONF0(u), UART_TXD_BRK);
+            dmx_phase[u] = DMX_IN_MAB;
+            dmx_due[u] = now + dmx_mab_time[u];
+        } else if (dmx_phase[u] == DMX_IN_MAB && due) {
+            dmx_phase[u] = DMX_IDLE;
+            SET_PERI_REG_MASK(UART_INT_ENA(u), UART_TXFIFO_EMPTY_INT_ENA);
+        }
+
+        if (dmx_phase[u] != DMX_IDLE)
+            next = std::min(next, dmx_due[u] - now);
+    }
+
+    if (next == UINT32_MAX)
+        timer1_disable();
+    else
+        timer1_write(DMX_TICKS(std::max<uint32_t>(next, 1)));
+}
+
+void SerialDriver::setBreak(uint16_t brk, uint16_t mab) {
+    _break = constrain(brk, DMX_BREAK, DMX_TIMING_MAX);
+    _mab = constrain(mab, DMX_MAB, DMX_TIMING_MAX);
+    if (_type == SerialType::DMX512) {
+        _overhead = _break + _mab;
+        frameTime = ceil(_byteTime * static_cast<float>(_size)
+                + static_cast<float>(_overhead));
+    }
+}
+
+void SerialDriver::buildCurves() {
+    for (uint16_t i = 0; i < 256; i++) {
+        curve_table[static_cast<uint8_t>(SerialCurve::LINEAR)][i] = i;
+        curve_table[static_cast<uint8_t>(SerialCurve::SQUARE)][i] = (i * i + 127) / 255;
+        // x^2 * (3 - 2x) with x = i / 255
+        uint32_t s = i * i * (765 - 2 * i);
+        curve_table[static_cast<uint8_t>(SerialCurve::SCURVE)][i] = (s + 32512) / 65025;
+    }
+    setCustomCurve(nullptr);
+}
+
+void SerialDriver::setCustomCurve(const uint8_t *table) {
+    uint8_t *custom = curve_table[static_cast<uint8_t>(SerialCurve::CUSTOM)];
+    if (table)
+        memcpy(custom, table, 256);
+    else
+        memcpy(custom, curve_table[static_cast<uint8_t>(SerialCurve::LINEAR)], 256);
+}
+
+/*
+* Each channel carries a profile index, and profiles point at the shared
+* curve tables, so a curved channel costs one extra lookup on the way in.
+* Fading channels keep a target and an 8.8 level that fade() moves once
+* per output frame.
+*/
+void SerialDriver::setProfiles(const serial_profile_t *profiles, uint8_t count,
+        uint16_t offset) {
+    free(_profile);
+    free(_target);
+    free(_next);
+    free(_level);
+    _profile = _target = _next = nullptr;
+    _level = nullptr;
+    _cntProfiles = 0;
+    _fading = false;
+
+    if (!count || !_serialdata)
+        return;
+
+    uint8_t header = _type == SerialType::RENARD ? 2 : 1;
+    _channels = _size - header;
+    _profile = static_cast<uint8_t *>(calloc(_channels, 1));
+    _target = static_cast<uint8_t *>(malloc(_channels));
+    _next = static_cast<uint8_t *>(malloc(_channels));
+    _level = static_cast<uint16_t *>(malloc(_channels * sizeof(uint16_t)));
+    if (!_profile || !_target || !_next || !_level) {
+        setProfiles(nullptr, 0);
+        return;
+    }
+
+    _lut[0] = curve_table[static_cast<uint8_t>(SerialCurve::LINEAR)];
+    _fadeMs[0] = 0;
+    for (uint8_t i = 0; i < count && _cntProfiles < SERIAL_PROFILES; i++) {
+        const serial_profile_t &p = profiles[i];
+        uint8_t curve = std::min(static_cast<uint8_t>(p.curve),
+                static_cast<uint8_t>(SERIAL_CURVES - 1));
+        uint8_t index = ++_cntProfiles;
+        _lut[index] = curve_table[curve];
+        _fadeMs[index] = std::min<uint16_t>(p.fade, SERIAL_FADE_MAX);
+
+        uint32_t start = std::max<uint32_t>(p.start, offset) - offset;
+        uint32_t end = std::min<uint32_t>(p.start + p.count, offset + _channels);
+        for (uint32_t ch = start; ch + offset < end; ch++)
+            _profile[ch] = index;
+    }
+
+    // Fade from the newest frame, the front buffer if none is pending
+    const uint8_t *frame = _frameStale ? _asyncdata : _framedata;
+    for (uint16_t ch = 0; ch < _channels; ch++) {
+        _target[ch] = _next[ch] = frame[ch + header];
+        _level[ch] = _target[ch] << 8;
+    }
+}
+
+/*
+* Fading channels take their target at commit(), so a frame still coming
+* in doesn't start them early. Their slots in the rotated-in frame hold
+* whatever that buffer had, so the current levels go back in.
+*/
+void SerialDriver::latchTargets() {
+    uint8_t header = _type == SerialType::RENARD ? 2 : 1;
+    for (uint16_t ch = 0; ch < _channels; ch++) {
+        if (!_fadeMs[_profile[ch]])
+            continue;
+        if (_target[ch] != _next[ch]) {
+            _target[ch] = _next[ch];
+            if (!_fading)
+                _fadeStamp = micros();
+            _fading = true;
+        }
+        _framedata[ch + header] = _level[ch] >> 8;
+    }
+}
+
+/*
+* Steps scale with the time since the last pass, so a fade takes the same
+* time at any frame rate. Fading channels are stepped in the committed
+* frame every pass until they all settle.
+*/
+void SerialDriver::fade() {
+    uint32_t now = micros();
+    uint32_t elapsed = now - _fadeStamp;
+    _fadeStamp = now;
+
+    uint16_t step[SERIAL_PROFILES + 1];
+    for (uint8_t p = 0; p <= _cntProfiles; p++) {
+        if (!_fadeMs[p])
+            continue;
+        uint64_t s = 65280ULL * elapsed / (_fadeMs[p] * 1000UL);
+        step[p] = constrain(s, 1, 65280);
+    }
+
+    /*
+    * Step in the newest frame. With nothing pending that's the front
+    * buffer, so the spare is caught up from it first (DMX only, Renard's
+    * _framedata is never stale).
+    */
+    if (_frameStale) {
+        memcpy(_framedata, _asyncdata, _frameStale);
+        _frameStale = 0;
+    }
+
+    uint8_t header = _type == SerialType::RENARD ? 2 : 1;
+    uint16_t end = 0;
+    bool moving = false;
+    for (uint16_t ch = 0; ch < _channels; ch++) {
+        uint8_t p = _profile[ch];
+        if (!_fadeMs[p])
+            continue;
+
+        uint16_t level = _level[ch];
+        uint16_t target = _target[ch] << 8;
+        if (level < target) {
+            level = target - level > step[p] ? level + step[p] : target;
+            moving = true;
+        } else if (level > target) {
+            level = level - target > step[p] ? level - step[p] : target;
+            moving = true;
+        }
+        _level[ch] = level;
+        if (_framedata[ch + header] != level >> 8) {
+            _framedata[ch + header] = level >> 8;
+            end = ch + header + 1;
+        }
+    }
+
+    _fading = moving;
+    if (end) {
+        _asyncStale = std::max(_asyncStale, end);
+        _pending = true;
+    }
+}
+
+void SerialDriver::setTargetFps(uint8_t fps) {
+    _frameInterval = fps ? 1000000UL / fps : 0;
+}
+
+/*
+* Output governor, see PixelDriver::commit(). The receive buffer becomes
+* _framedata, which is all show() sends. Frames committed while the port is
+* busy count as late, ones replaced before going out as coalesced.
+*/
+void SerialDriver::commit() {
+    if (_servicing) {
+        _deferred = true;
+        return;
+    }
+    if (!_fresh) return;
+    _fresh = false;
+
+    if (_pending)
+        stats.coalesced++;
+    else if (isBusy() || !canRefresh())
+        stats.late++;
+    _pending = true;
+
+    /*
+    * Swap the receive buffer in. The one it replaces, a coalesced frame
+    * or the spare, is the new receive buffer and only copies the bytes it
+    * lags by.
+    */
+    _frameStale = std::max(_frameStale, _dirty);
+    _asyncStale = std::max(_asyncStale, _dirty);
+    std::swap(_serialdata, _framedata);
+    memcpy(_serialdata, _framedata, _frameStale);
+    _frameStale = 0;
+    _dirty = 0;
+
+    if (_profile)
+        latchTargets();
+}
+
+void SerialDriver::service() {
+    if (isBusy() || !canRefresh())
+        return;
+
+    _servicing = true;
+
+    /* Fades advance at the port's frame rate, each step is a frame */
+    if (_fading)
+        fade();
+
+    if (_pending) {
+        _pending = false;
+        stats.presented++;
+        show();
+    } else if ((millis() - _fullTime) >= _fullRefresh) {
+        show();     // Refresh what's already out
     }
+    _servicing = false;
 
-#if SEROUT_UART == 0
-    /* Clear UART1 if needed */
-    if (READ_PERI_REG(UART_INT_ST(UART1)))
-        WRITE_PERI_REG(UART_INT_CLR(UART1), 0xffff);
-#elif SEROUT_UART == 1
-    /* Clear if UART0 if needed */
-    if (READ_PERI_REG(UART_INT_ST(UART0)))
-        WRITE_PERI_REG(UART_INT_CLR(UART0), 0xffff);
-#endif
+    if (_deferred) {
+        _deferred = false;
+        commit();
+    }
 }
 
+bool SerialDriver::isBusy() {
+    return uart_buffer[_uart] != uart_buffer_tail[_uart];
+}
 
 void SerialDriver::show() {
     if (!_serialdata) return;
 
-    /* Copy data to the idle buffer and swap it */
-    memcpy(_asyncdata, _serialdata, _size);
+    /* Never touch the front buffer while it's being sent */
+    if (isBusy()) return;
+
+    /*
+    * Receivers hold their last values, so an unchanged frame isn't resent
+    * and a changed one stops after the last changed channel; both DMX512
+    * and Renard allow short frames. A full frame still goes out every
+    * _fullRefresh ms in case a receiver missed one.
+    */
+    bool full = (millis() - _fullTime) >= _fullRefresh;
+    if (!_asyncStale && !full)
+        return;
+
+    uint16_t len = full ? _size : _asyncStale;
+    bool all = len == _size;
+    if (all)
+        _fullTime = millis();
+
+    /*
+    * Hand the committed frame to the ISR, the old front comes back as the
+    * spare. If nothing was committed since, the front is resent as is.
+    * Renard is escaped into the TX buffer instead, which changes the frame
+    * length.
+    */
+    if (_type == SerialType::RENARD) {
+        len = encodeRenard(len);
+        _asyncStale = 0;
+    } else if (_asyncStale) {
+        std::swap(_asyncdata, _framedata);
+        std::swap(_asyncStale, _frameStale);
+    }
 
-    uart_buffer = _asyncdata;
-    uart_buffer_tail = _asyncdata + _size;
+    uart_buffer[_uart] = _asyncdata;
+    uart_buffer_tail[_uart] = _asyncdata + len;
 
+    /* DMX starts with the break, handleBreak() starts the data after the MAB */
     if (_type == SerialType::DMX512) {
-        SET_PERI_REG_MASK(UART_CONF0(SEROUT_UART), UART_TXD_BRK);
-        delayMicroseconds(DMX_BREAK);
-        CLEAR_PERI_REG_MASK(UART_CONF0(SEROUT_UART), UART_TXD_BRK);
-        delayMicroseconds(DMX_MAB);
+        noInterrupts();
+        SET_PERI_REG_MASK(UART_CONF0(_uart), UART_TXD_BRK);
+        dmx_phase[_uart] = DMX_IN_BREAK;
+        dmx_due[_uart] = micros() + _break;
+        dmx_mab_time[_uart] = _mab;
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+        handleBreak();
+        interrupts();
+    } else {
+        SET_PERI_REG_MASK(UART_INT_ENA(_uart), UART_TXFIFO_EMPTY_INT_ENA);
     }
 
-    SET_PERI_REG_MASK(UART_INT_ENA(SEROUT_UART), UART_TXFIFO_EMPTY_INT_ENA);
-
     startTime = micros();
-
-//    std::swap(_asyncdata, _serialdata);
+    txTime = ceil(_byteTime * static_cast<float>(len)) + _overhead;
+    if (all)
+        frameTime = txTime;
 }
 
 
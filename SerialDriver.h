@@ -33,8 +33,12 @@ GNU General Public License for more details.
 
 #if SEROUT_UART == 0
 #define SEROUT_PORT        Serial
+#define SEROUT2_UART       1
+#define SEROUT2_PORT       Serial1
 #elif SEROUT_UART == 1
 #define SEROUT_PORT        Serial1
+#define SEROUT2_UART       0
+#define SEROUT2_PORT       Serial
 #else
 #error "Invalid SEROUT_UART specified"
 #endif
@@ -42,6 +46,37 @@ GNU General Public License for more details.
 /* DMX minimum timings per E1.11 */
 #define DMX_BREAK 92
 #define DMX_MAB 12
+#define DMX_TIMING_MAX  1000    /* Longest break / MAB we'll generate */
+
+/* timer1 runs at 80MHz / 16, 5 ticks per microsecond */
+#define DMX_TICKS(us)   ((us) * 5)
+
+/* Renard framing, 0x7D - 0x7F in the data go out as RENARD_ESC, value - 0x4E */
+#define RENARD_PAD      0x7D
+#define RENARD_SYNC     0x7E
+#define RENARD_ESC      0x7F
+#define RENARD_ADDR     0x80
+#define RENARD_ESC_OFFSET   0x4E
+
+/* Response curves, one shared table each */
+enum class SerialCurve : uint8_t {
+    LINEAR,
+    SQUARE,     /* Square law, close to how incandescent dimmers look */
+    SCURVE,     /* Smoothstep, gentle at both ends */
+    CUSTOM      /* 256 entry table from the config */
+};
+
+#define SERIAL_CURVES   4
+#define SERIAL_PROFILES 8       /* Channel ranges with their own curve and fade */
+#define SERIAL_FADE_MAX 60000   /* Longest fade in ms */
+
+/* Curve and fade time for a range of channels */
+typedef struct {
+    uint16_t    start;      /* First channel, 0 based from channel_start */
+    uint16_t    count;      /* Number of channels */
+    SerialCurve curve;      /* Response curve */
+    uint16_t    fade;       /* ms to fade across the full range, 0 = snap */
+} serial_profile_t;
 
 /* Serial Types */
 enum class SerialType : uint8_t {
@@ -58,64 +93,191 @@ enum class BaudRate : uint32_t {
     BR_460800 = 460800
 };
 
+/* Output governor statistics */
+typedef struct {
+    uint32_t presented;     /* Frames sent to the port */
+    uint32_t coalesced;     /* Frames replaced by a newer one before going out */
+    uint32_t late;          /* Frames that had to wait for the port */
+} serial_stats_t;
+
 class SerialDriver {
  public:
+    serial_stats_t stats;   // Output statistics
+
+    /* Each instance owns a UART, the second universe goes on SEROUT2_UART */
+    explicit SerialDriver(uint8_t uart = SEROUT_UART) : _uart(uart) {}
+
     int begin(HardwareSerial *theSerial, SerialType type, uint16_t length);
     int begin(HardwareSerial *theSerial, SerialType type, uint16_t length,
             BaudRate baud);
     void show();
     uint8_t* getData();
 
-    /* Set the value */
+    /*
+    * Mark the data written so far as a complete frame. Safe to call from
+    * network callbacks: one landing while service() is fading or sending
+    * _framedata (it yielded) is held until service() is done with it.
+    */
+    void commit();
+
+    /* Send the newest complete frame once the port and frame rate allow */
+    void service();
+
+    /* Cap the output frame rate, 0 = as fast as the port allows */
+    void setTargetFps(uint8_t fps);
+
+    /* DMX break and mark after break in us, raised to the E1.11 minimums */
+    void setBreak(uint16_t brk, uint16_t mab);
+
+    /*
+    * Curve and fade per channel range, call after begin(). offset is the
+    * channel this port starts at, ranges outside the port are skipped.
+    */
+    void setProfiles(const serial_profile_t *profiles, uint8_t count,
+            uint16_t offset = 0);
+
+    /* Load the CUSTOM curve, shared by every port. nullptr = linear */
+    static void setCustomCurve(const uint8_t *table);
+
+    /* Highest frame rate the port can take */
+    inline uint16_t getMaxFps() {
+        return frameTime ? 1000000UL / frameTime : 0;
+    }
+
+    /* Set the value, through the channel's curve and fade if it has one */
     inline void setValue(uint16_t address, uint8_t value) {
-    // Avoid the special characters by rounding
-        if (_type == SerialType::RENARD) {
-            switch (value) {
-                case 0x7d:
-                    _serialdata[address + 2] = 0x7c;
-                    break;
-                case 0x7e:
-                case 0x7f:
-                    _serialdata[address + 2] = 0x80;
-                    break;
-                default:
-                    _serialdata[address + 2] = value;
-                    break;
-            }
-        } else if (_type == SerialType::DMX512) {
-            _serialdata[address + 1] = value;
-        }
+        if (_profile)
+            setLevel(address, value);
+        else
+            writeValue(address, value);
     }
 
+    /* Set len values from address on, same rules as setValue() */
+    void setValues(uint16_t address, const uint8_t *src, uint16_t len);
+
     /* Drop the update if our refresh rate is too high */
     inline bool canRefresh() {
-        return (micros() - startTime) >= frameTime;
+        return (micros() - startTime) >= std::max(txTime, _frameInterval);
+    }
+
+    /* Resend every channel at least every ms milliseconds, 0 = always */
+    inline void setFullRefresh(uint16_t ms) {
+        _fullRefresh = ms;
     }
 
+    /* True while the ISR is still sending the front buffer */
+    bool isBusy();
+
  private:
     SerialType      _type;          // Output Serial type
+    uint8_t         _uart;          // UART behind _serial
     HardwareSerial  *_serial;       // The Serial Port
     uint16_t        _size;          // Size of buffer
-    uint8_t         *_serialdata;   // Serial data buffer
-    uint8_t         *_asyncdata;    // Async buffer
+    /*
+    * DMX rotates three buffers, receive -> committed -> front -> receive,
+    * swapping pointers rather than copying frames. A buffer coming back as
+    * the receive buffer is only caught up on the bytes that changed since
+    * it last held the newest frame. Renard escapes the committed frame into
+    * its own TX buffer, so only receive and committed rotate.
+    */
+    uint8_t         *_serialdata;   // Receive buffer, written by receivers
+    uint8_t         *_framedata;    // Last committed frame, what show() sends
+    uint8_t         *_asyncdata;    // Front buffer / Renard TX buffer, owned by the ISR
+    uint16_t        _dirty;         // Bytes up to the last changed one, 0 if none
+    uint16_t        _frameStale;    // Bytes _framedata may lag the newest frame by
+    uint16_t        _asyncStale;    // Same for what's in / was last sent from _asyncdata
+    uint16_t        _fullRefresh;   // Max ms between full frames
+    uint32_t        _fullTime;      // When the last full frame TX started, in millis
+    float           _byteTime;      // Time to TX one byte
+    uint32_t        _overhead;      // Fixed time added to each frame
+    uint16_t        _break;         // DMX break time
+    uint16_t        _mab;           // DMX mark after break time
     uint32_t        frameTime;      // Time it takes for a frame TX to complete
+    uint32_t        txTime;         // Time until we can refresh after starting the last TX
     uint32_t        startTime;      // When the last frame TX started
+    uint32_t        _frameInterval; // Min time between frames for the target rate
+    bool            _fresh;         // Data changed since the last commit()
+    bool            _pending;       // A committed frame is waiting to go out
+    bool            _servicing;     // service() is using _framedata
+    bool            _deferred;      // commit() came in during service()
+
+    /* Profiles, index 0 is linear with no fade for channels without one */
+    uint8_t         *_profile;      // Profile of each channel, nullptr if none set
+    uint8_t         *_target;       // Curved value each fading channel heads for
+    uint8_t         *_next;         // Same, as received since the last commit()
+    uint16_t        *_level;        // Output level of each channel in 8.8
+    uint16_t        _channels;      // Channels in the profile buffers
+    const uint8_t   *_lut[SERIAL_PROFILES + 1];     // Curve of each profile
+    uint16_t        _fadeMs[SERIAL_PROFILES + 1];   // Fade time of each profile
+    uint8_t         _cntProfiles;   // Profiles in use
+    bool            _fading;        // Some channel hasn't reached its target
+    uint32_t        _fadeStamp;     // When the last fade pass ran, in micros
+
+    static uint8_t  renard_escape[256]; // Escape code of each value, 0 if sent as is
+    static uint8_t  curve_table[SERIAL_CURVES][256];    // Shared response curves
+
+    /*
+    * Write an output value into the receive buffer, past the DMX start
+    * code or the Renard header. commit() rotates it in as _framedata.
+    */
+    inline void writeValue(uint16_t address, uint8_t value) {
+        uint16_t offset = address + (_type == SerialType::RENARD ? 2 : 1);
+        if (_serialdata[offset] != value) {
+            _serialdata[offset] = value;
+            markDirty(offset + 1);
+        }
+    }
 
+    /*
+    * Write a value through its channel's curve. Fading channels only take
+    * a target here, fade() owns their slots in the frame.
+    */
+    inline void setLevel(uint16_t address, uint8_t value) {
+        uint8_t p = _profile[address];
+        if (!_fadeMs[p]) {
+            writeValue(address, _lut[p][value]);
+        } else if (_next[address] != _lut[p][value]) {
+            _next[address] = _lut[p][value];
+            _fresh = true;
+        }
+    }
+
+    /* Start fades to the committed targets, put the levels in the frame */
+    void latchTargets();
+
+    /* Step fading channels towards their targets, once per output frame */
+    void fade();
+
+    /* Build the fixed curves and a linear CUSTOM one */
+    static void buildCurves();
+
+    inline void markDirty(uint16_t end) {
+        _fresh = true;
+        if (end > _dirty)
+            _dirty = end;
+    }
+
+    /* Escape _framedata up to len into _asyncdata, returns the TX length */
+    uint16_t encodeRenard(uint16_t len);
 
     /* Fill the FIFO */
-    static const uint8_t* ICACHE_RAM_ATTR fillFifo(const uint8_t *buff, const uint8_t *tail);
+    static const uint8_t* ICACHE_RAM_ATTR fillFifo(uint8_t uart,
+            const uint8_t *buff, const uint8_t *tail);
 
-    /* Serial interrupt handler */
+    /* Serial interrupt handler, shared by both UARTs */
     static void ICACHE_RAM_ATTR serial_handle(void *param);
 
-    /* Returns number of bytes waiting in the TX FIFO of UART1 */
-    static inline uint8_t getFifoLength() {
-        return (U1S >> USTXC) & 0xff;
+    /* timer1 handler ending the DMX break / MAB of either UART */
+    static void ICACHE_RAM_ATTR handleBreak();
+
+    /* Returns number of bytes waiting in the TX FIFO of a UART */
+    static inline uint8_t getFifoLength(uint8_t uart) {
+        return (USS(uart) >> USTXC) & 0xff;
     }
 
-    /* Append a byte to the TX FIFO of UART1 */
-    static inline void enqueue(uint8_t byte) {
-        U1F = byte;
+    /* Append a byte to the TX FIFO of a UART */
+    static inline void enqueue(uint8_t uart, uint8_t byte) {
+        USF(uart) = byte;
     }
 };
 
@@ -1,10 +1,95 @@
 #include <Arduino.h>
+#include "gamma.h"
 
-uint8_t GAMMA_TABLE[256] = { 0 };
+uint8_t GAMMA_TABLE[GAMMA_CHANNELS][256] = { 0 };
+uint16_t GAMMA_TABLE16[GAMMA_CHANNELS][256] = { 0 };
 
-void updateGammaTable(float gammaVal, float briteVal) {
-  for (int i = 0; i < 256; i++) {
-    GAMMA_TABLE[i] = (uint8_t) min((255.0 * pow(i * briteVal / 255.0, gammaVal) + 0.5), 255.0);
+/* 2^(-1/2), 2^(-1/4) ... 2^(-1/65536) in 1.31 fixed point */
+static const uint32_t EXP2_NEG[16] = {
+  0x5a82799a, 0x6ba27e65, 0x75606374, 0x7a92be8b,
+  0x7d41d96e, 0x7e9f0606, 0x7f4f08ae, 0x7fa765ad,
+  0x7fd3ab29, 0x7fe9d3a9, 0x7ff4e959, 0x7ffa748e,
+  0x7ffd3a3f, 0x7ffe9d1e, 0x7fff4e8e, 0x7fffa747
+};
+
+/* R / G / B multipliers from 2000K to 10000K in 500K steps, 6500K is neutral */
+static const uint8_t COLOR_TEMP[17][3] = {
+  { 255, 137,  14 }, { 255, 159,  70 }, { 255, 177, 110 }, { 255, 193, 141 },
+  { 255, 206, 166 }, { 255, 218, 187 }, { 255, 228, 206 }, { 255, 237, 222 },
+  { 255, 246, 237 }, { 255, 254, 250 }, { 243, 242, 255 }, { 230, 235, 255 },
+  { 221, 230, 255 }, { 215, 226, 255 }, { 210, 223, 255 }, { 205, 220, 255 },
+  { 202, 218, 255 }
+};
+
+/* log2(v) in 16.16 fixed point for v >= 1 */
+static int32_t log2_q16(uint32_t v) {
+  int32_t ipart = 31 - __builtin_clz(v);
+  uint32_t m = ipart > 30 ? v >> 1 : v << (30 - ipart);  // [1, 2) in 2.30
+  int32_t fpart = 0;
+
+  for (int32_t bit = 0x8000; bit; bit >>= 1) {
+    m = (static_cast<uint64_t>(m) * m) >> 30;
+    if (m >= 0x80000000UL) {
+      m >>= 1;
+      fpart |= bit;
+    }
+  }
+  return (ipart << 16) | fpart;
+}
+
+/* 2^-a for a >= 0 in 16.16 fixed point, result in 16.16 */
+static uint32_t exp2neg_q16(uint32_t a) {
+  uint32_t ipart = a >> 16;
+  if (ipart > 16)
+    return 0;
+
+  uint32_t r = 0x80000000UL;    // 1.0 in 1.31
+  for (uint8_t k = 0; k < 16; k++) {
+    if (a & (0x8000 >> k))
+      r = (static_cast<uint64_t>(r) * EXP2_NEG[k]) >> 31;
   }
+  return (r >> 15) >> ipart;
 }
 
+/*
+* Curves are built in fixed point, the ESP8266 has no FPU: one log2 / exp2
+* pair per input level for the shared gamma curve, then a multiply per
+* channel for brightness, white balance and color temperature. Only the
+* per channel scales use floats. bench_gamma times it on the host.
+*/
+void updateGammaTable(float gammaVal, float briteVal, const float *balance,
+        uint16_t colorTemp) {
+  uint32_t gamma = gammaVal * 65536.0;
+  int32_t log255 = log2_q16(255);
+
+  // Per channel scale in 16.16, capped at 1.0. Brightness scales the input
+  // level, so it lands on the output as briteVal ^ gammaVal.
+  float brite = pow(briteVal, gammaVal);
+  uint32_t scale[GAMMA_CHANNELS];
+  for (uint8_t ch = 0; ch < GAMMA_CHANNELS; ch++) {
+    float s = brite;
+    if (balance)
+      s *= balance[ch];
+    if (colorTemp && ch < 3) {
+      uint8_t t = (constrain(colorTemp, 2000, 10000) - 2000 + 250) / 500;
+      s *= COLOR_TEMP[t][ch] / 255.0;
+    }
+    scale[ch] = constrain(s, 0.0, 1.0) * 65536.0;
+  }
+
+  for (int i = 0; i < 256; i++) {
+    // (i / 255) ^ gamma in 16.16
+    uint32_t level = 0;
+    if (i) {
+      int64_t a = static_cast<int64_t>(log255 - log2_q16(i)) * gamma >> 16;
+      level = exp2neg_q16(a);
+    }
+
+    for (uint8_t ch = 0; ch < GAMMA_CHANNELS; ch++) {
+      uint32_t val = (static_cast<uint64_t>(level) * scale[ch]) >> 16;
+      GAMMA_TABLE[ch][i] = (val * 255 + 0x8000) >> 16;
+      // 8.8 fixed point capped at 255.0 so the dither residue can't overflow
+      GAMMA_TABLE16[ch][i] = (static_cast<uint64_t>(val) * 65280 + 0x8000) >> 16;
+    }
+  }
+}
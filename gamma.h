@@ -1,9 +1,19 @@
 #ifndef GAMMA_H_
 #define GAMMA_H_
 
-/* Gamma correction table */
-extern uint8_t GAMMA_TABLE[];
+#define GAMMA_CHANNELS  4   /* R, G, B, W */
 
-void updateGammaTable(float gammaVal, float briteVal);
+/* Gamma correction tables, one per source channel */
+extern uint8_t GAMMA_TABLE[GAMMA_CHANNELS][256];
+
+/* Same curves in 8.8 fixed point for dithering */
+extern uint16_t GAMMA_TABLE16[GAMMA_CHANNELS][256];
+
+/*
+* Build the tables. balance is an optional per channel scale, colorTemp
+* tints R / G / B towards a white point in Kelvin, 0 to disable.
+*/
+void updateGammaTable(float gammaVal, float briteVal,
+        const float *balance = nullptr, uint16_t colorTemp = 0);
 
 #endif /* GAMMA_H_ */
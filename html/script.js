@@ -7,6 +7,9 @@ var wsTimerId;
 // json with effect definitions
 var effectInfo;
 
+// Custom serial curve, kept as loaded
+var customCurve;
+
 // Default modal properties
 $.fn.modal.Constructor.DEFAULTS.backdrop = 'static';
 $.fn.modal.Constructor.DEFAULTS.keyboard = false;
@@ -193,6 +196,15 @@ $(function() {
             sendGamma();
     });
 
+    // Second string
+    $('#p2_enabled').click(function() {
+        if ($(this).is(':checked')) {
+            $('.p2').removeClass('hidden');
+       } else {
+            $('.p2').addClass('hidden');
+       }
+    });
+
     // Gamma graph
     $('#showgamma').click(function() {
         if ($(this).is(':checked')) {
@@ -615,13 +627,33 @@ function getConfig(data) {
     if (config.device.mode & 0x01) {  // Pixel
         mode = 'pixel';
         $('#o_pixel').removeClass('hidden');
-        $('#p_count').val(config.e131.channel_count / 3);
         $('#p_type').val(config.pixel.type);
         $('#p_color').val(config.pixel.color);
+        $('#p_count').val(config.e131.channel_count / pixelChannels());
         $('#p_groupSize').val(config.pixel.groupSize);
         $('#p_zigSize').val(config.pixel.zigSize);
         $('#p_gammaVal').val(config.pixel.gammaVal);
         $('#p_briteVal').val(config.pixel.briteVal);
+        $('#p_dither').prop('checked', config.pixel.dither);
+        $('#p_interpolate').prop('checked', config.pixel.interpolate);
+        $('#p_powerLimit').val(config.pixel.powerLimit);
+        $('#p_channelMa').val(config.pixel.channelMa);
+        var segments = (config.pixel.segments || []).length +
+                (config.pixel.port2 && config.pixel.port2.segments || []).length;
+        $('#p_segments').prop('checked', segments > 0).prop('disabled', segments == 0);
+        if (config.pixel.port2) {
+            var p2 = config.pixel.port2;
+            $('#p2_enabled').prop('checked', p2.enabled);
+            $('#p2_color').val(p2.color);
+            $('#p2_start').val(p2.start);
+            $('#p2_count').val(p2.count / pixelChannels('#p2_color'));
+            $('#p2_groupSize').val(p2.groupSize);
+            $('#p2_zigSize').val(p2.zigSize);
+            if (p2.enabled)
+                $('.p2').removeClass('hidden');
+            else
+                $('.p2').addClass('hidden');
+        }
 
 //      if(config.e131.channel_count / 3 <8 ) {
 //          $('#v_columns').val(config.e131.channel_count / 3);
@@ -630,7 +662,7 @@ function getConfig(data) {
 //      } else {
 //          $('#v_columns').val(25);
 //      }
-        $('#v_columns').val(Math.floor(Math.sqrt(config.e131.channel_count/3)));
+        $('#v_columns').val(Math.floor(Math.sqrt(config.e131.channel_count / pixelChannels())));
 
         $("input[name='viewStyle'][value='RGB']").trigger('click');
         clearStream();
@@ -646,6 +678,13 @@ function getConfig(data) {
         $('#s_count').val(config.e131.channel_count);
         $('#s_proto').val(config.serial.type);
         $('#s_baud').val(config.serial.baudrate);
+        $('#s_dmxBreak').val(config.serial.dmxBreak);
+        $('#s_dmxMab').val(config.serial.dmxMab);
+        $('#s2_enabled').prop('checked', config.serial.port2.enabled);
+        $('#s2_start').val(config.serial.port2.start);
+        $('#s_profiles').empty();
+        $.each(config.serial.profiles || [], function(i, p) { addProfile(p); });
+        customCurve = config.serial.customCurve;
 
         if (config.e131.channel_count<=64 ) {
             $('#v_columns').val(8);
@@ -743,8 +782,26 @@ function getJsonStatus(data) {
     $('#uni_last').text(status.e131.uniLast);
     $('#pkts').text(status.e131.num_packets);
     $('#serr').text(status.e131.seq_errors);
+    $('#stale').text(status.e131.stale);
     $('#perr').text(status.e131.packet_errors);
     $('#clientip').text(status.e131.last_clientIP);
+
+// getOutputStatus(data)
+    $('#o_presented').text(status.output.presented);
+    $('#o_coalesced').text(status.output.coalesced);
+    $('#o_late').text(status.output.late);
+    $('#o_overflows').text(status.output.overflows);
+    $('#o_torn').text(status.output.torn);
+    $('#o_lateFrames').text(status.output.late_frames);
+    $('#o_maxfps').text(status.output.max_fps);
+    if (typeof status.output.current !== 'undefined') {
+        $('.o_power').removeClass('hidden');
+        $('#o_current').text(status.output.current);
+        $('#o_peak').text(status.output.peak);
+        $('#o_limit').text(status.output.limit);
+    } else {
+        $('.o_power').addClass('hidden');
+    }
 }
 
 function refreshGamma(data) {
@@ -803,7 +860,7 @@ function submitWiFi() {
 function submitConfig() {
     var channels = parseInt($('#s_count').val());
     if (mode == 'pixel')
-        channels = parseInt($('#p_count').val()) * 3;
+        channels = parseInt($('#p_count').val()) * pixelChannels();
 
     var json = {
             'device': {
@@ -833,14 +890,47 @@ function submitConfig() {
                 'groupSize': parseInt($('#p_groupSize').val()),
                 'zigSize': parseInt($('#p_zigSize').val()),
                 'gammaVal': parseFloat($('#p_gammaVal').val()),
-                'briteVal': parseFloat($('#p_briteVal').val())
+                'briteVal': parseFloat($('#p_briteVal').val()),
+                'dither': $('#p_dither').prop('checked'),
+                'interpolate': $('#p_interpolate').prop('checked'),
+                'powerLimit': parseInt($('#p_powerLimit').val()),
+                'channelMa': parseInt($('#p_channelMa').val()),
+                'port2': {
+                    'enabled': $('#p2_enabled').prop('checked'),
+                    'color': parseInt($('#p2_color').val()),
+                    'start': parseInt($('#p2_start').val()),
+                    'count': parseInt($('#p2_count').val()) * pixelChannels('#p2_color'),
+                    'groupSize': parseInt($('#p2_groupSize').val()),
+                    'zigSize': parseInt($('#p2_zigSize').val())
+                }
             },
             'serial': {
                 'type': parseInt($('#s_proto').val()),
-                'baudrate': parseInt($('#s_baud').val())
+                'baudrate': parseInt($('#s_baud').val()),
+                'dmxBreak': parseInt($('#s_dmxBreak').val()),
+                'dmxMab': parseInt($('#s_dmxMab').val()),
+                'port2': {
+                    'enabled': $('#s2_enabled').prop('checked'),
+                    'start': parseInt($('#s2_start').val())
+                },
+                'profiles': $('#s_profiles .s_profile').map(function() {
+                    return {
+                        'start': parseInt($(this).find('.s_pstart').val()),
+                        'count': parseInt($(this).find('.s_pcount').val()),
+                        'curve': parseInt($(this).find('.s_pcurve').val()),
+                        'fade': parseInt($(this).find('.s_pfade').val())
+                    };
+                }).get(),
+                'customCurve': customCurve
             }
     };
 
+    // Virtual strings come from ZCPP, the UI can only clear them
+    if (!$('#p_segments').prop('checked')) {
+        json.pixel.segments = [];
+        json.pixel.port2.segments = [];
+    }
+
     wsEnqueue('S2' + JSON.stringify(json));
 }
 
@@ -878,35 +968,82 @@ function refreshPixel() {
     var frame = 30;
     var idle = 300;
 
-    if (!proto.localeCompare('WS2811 800kHz')) {
+    if (!proto.localeCompare('WS2811 800kHz') ||
+            !proto.localeCompare('WS2811 800kHz (I2S DMA)')) {
         frame = 30;
         idle = 300;
+    } else if (!proto.localeCompare('WS2811 800kHz (3 bit UART)')) {
+        frame = 27;
+        idle = 300;
     } else if (!proto.localeCompare('GE Color Effects')) {
         frame = 790;
         idle = 35;
+    } else if (!proto.localeCompare('APA102 (SPI)')) {
+        frame = 4;
+        idle = 0;
+    } else if (!proto.localeCompare('WS2801 (SPI)')) {
+        frame = 24;
+        idle = 500;
+    } else if (!proto.localeCompare('LPD8806 (SPI)')) {
+        frame = 12;
+        idle = 0;
     }
 
-    var rate = (frame * size + idle) / 1000;
+    var rate = (frame * size * pixelChannels() / 3 + idle) / 1000;
     var hz = 1000 / rate;
     $('#refresh').html(Math.ceil(rate) + 'ms / ' + Math.floor(hz) + 'Hz');
 }
 
+// Channels per pixel, W color orders carry a white channel
+function pixelChannels(select) {
+    var color = $((select || '#p_color') + ' option:selected').text();
+    return color.charAt(color.length - 1) == 'W' ? 4 : 3;
+}
+
+// Serial curve / fade row, at most 8
+function addProfile(p) {
+    if ($('#s_profiles .s_profile').length >= 8)
+        return;
+    p = p || {'start': 0, 'count': 1, 'curve': 0, 'fade': 0};
+    var row = $('<div class="row s_profile">' +
+        '<div class="col-sm-2"><input type="text" class="form-control s_pstart" title="First channel"></div>' +
+        '<div class="col-sm-2"><input type="text" class="form-control s_pcount" title="Channels"></div>' +
+        '<div class="col-sm-3"><select class="form-control s_pcurve">' +
+            '<option value="0">Linear</option><option value="1">Square Law</option>' +
+            '<option value="2">S-Curve</option><option value="3">Custom</option></select></div>' +
+        '<div class="col-sm-3"><input type="text" class="form-control s_pfade" title="Fade time in ms, 0 to snap"></div>' +
+        '<div class="col-sm-2"><button type="button" class="btn btn-default">Remove</button></div>' +
+        '</div>');
+    row.find('.s_pstart').val(p.start);
+    row.find('.s_pcount').val(p.count);
+    row.find('.s_pcurve').val(p.curve);
+    row.find('.s_pfade').val(p.fade);
+    row.find('button').click(function() { row.remove(); });
+    $('#s_profiles').append(row);
+}
+
 function refreshSerial() {
     var proto = $('#s_proto option:selected').text();
     var baud = parseInt($('#s_baud').val());
     var size = parseInt($('#s_count').val());
     var symbol = 11;
+    var overhead = 0;
     if (!proto.localeCompare('Renard')) {
         symbol = 10;
         size = size + 2;
         $('#s_baud').prop('disabled', false);
+        $('.s_dmx').addClass('hidden');
     } else if (!proto.localeCompare('DMX512')) {
         symbol = 11;
+        size = size + 1;
         baud = 250000;
+        overhead = (Math.max(parseInt($('#s_dmxBreak').val()) || 0, 92) +
+                Math.max(parseInt($('#s_dmxMab').val()) || 0, 12)) / 1000;
         $('#s_baud').val(baud);
         $('#s_baud').prop('disabled', true);
+        $('.s_dmx').removeClass('hidden');
     }
-    var rate = symbol * 1000 / baud * size;
+    var rate = symbol * 1000 / baud * size + overhead;
     var hz = 1000 / rate;
     $('#refresh').html(Math.ceil(rate) + 'ms / ' + Math.floor(hz) + 'Hz');
 }
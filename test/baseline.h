@@ -0,0 +1,144 @@
+/*
+* baseline.h - The output paths as they were before frames were encoded in
+* show(), kept as the reference the tests and benchmarks compare against.
+* Apart from the FIFO going through USF() and the gamma table being passed
+* in, the code is as it was.
+*/
+
+#ifndef BASELINE_H_
+#define BASELINE_H_
+
+#include "host.h"
+#include "PixelDriver.h"
+
+namespace baseline {
+
+/* PixelDriver::updateOrder(), RGB orders only */
+struct Order {
+    uint8_t r, g, b;
+};
+
+inline Order order(PixelColor color) {
+    switch (color) {
+        case PixelColor::GRB:
+            return {1, 0, 2};
+        case PixelColor::BRG:
+            return {1, 2, 0};
+        case PixelColor::RBG:
+            return {0, 2, 1};
+        case PixelColor::GBR:
+            return {2, 0, 1};
+        case PixelColor::BGR:
+            return {2, 1, 0};
+        default:
+            return {0, 1, 2};
+    }
+}
+
+/*
+* The group / zigzag copy from PixelDriver::show(). A partial last zig used
+* to read past the end of pixdata, the driver now clamps it to the last
+* pixel and so does this.
+*/
+inline void layout(const uint8_t *pixdata, uint8_t *asyncdata,
+        uint16_t szBuffer, uint16_t cntGroup, uint16_t cntZigzag) {
+    int last = szBuffer / 3 - 1;
+    if (!cntZigzag) {  // Normal / group copy
+        for (size_t led = 0; led < szBuffer / 3; led++) {
+            uint16 modifier = led / cntGroup;
+            asyncdata[3 * led + 0] = pixdata[3 * modifier + 0];
+            asyncdata[3 * led + 1] = pixdata[3 * modifier + 1];
+            asyncdata[3 * led + 2] = pixdata[3 * modifier + 2];
+        }
+    } else {  // Zigzag copy
+        for (size_t led = 0; led < szBuffer / 3; led++) {
+            uint16 modifier = led / cntGroup;
+            if (led / cntZigzag % 2) { // Odd "zig"
+                int group = cntZigzag * (led / cntZigzag);
+                int this_led = (group + cntZigzag - (led % cntZigzag) - 1) / cntGroup;
+                this_led = std::min(this_led, last);
+                asyncdata[3 * led + 0] = pixdata[3 * this_led + 0];
+                asyncdata[3 * led + 1] = pixdata[3 * this_led + 1];
+                asyncdata[3 * led + 2] = pixdata[3 * this_led + 2];
+            } else { // Even "zag"
+                asyncdata[3 * led + 0] = pixdata[3 * modifier + 0];
+                asyncdata[3 * led + 1] = pixdata[3 * modifier + 1];
+                asyncdata[3 * led + 2] = pixdata[3 * modifier + 2];
+            }
+        }
+    }
+}
+
+/* PixelDriver::fillWS2811(), one TX FIFO empty interrupt's worth */
+inline const uint8_t* fillWS2811(const uint8_t *buff, const uint8_t *tail,
+        Order o, const uint8_t *gamma) {
+    uint8_t avail = UART_TX_FIFO_SIZE / 4;
+    if (tail - buff > avail)
+        tail = buff + avail;
+
+    while (buff + 2 < tail) {
+        uint8_t subpix = buff[o.r];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 6) & 0x3];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 4) & 0x3];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 2) & 0x3];
+        USF(UART) = LOOKUP_2811[gamma[subpix] & 0x3];
+
+        subpix = buff[o.g];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 6) & 0x3];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 4) & 0x3];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 2) & 0x3];
+        USF(UART) = LOOKUP_2811[gamma[subpix] & 0x3];
+
+        subpix = buff[o.b];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 6) & 0x3];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 4) & 0x3];
+        USF(UART) = LOOKUP_2811[(gamma[subpix] >> 2) & 0x3];
+        USF(UART) = LOOKUP_2811[gamma[subpix] & 0x3];
+
+        buff += 3;
+    }
+
+    return buff;
+}
+
+/* A whole WS2811 frame, laid out in show() and sent by the ISR */
+inline void showWS2811(const uint8_t *pixdata, uint8_t *asyncdata,
+        uint16_t szBuffer, uint16_t cntGroup, uint16_t cntZigzag,
+        PixelColor color, const uint8_t *gamma) {
+    layout(pixdata, asyncdata, szBuffer, cntGroup, cntZigzag);
+
+    Order o = order(color);
+    const uint8_t *buff = asyncdata;
+    const uint8_t *tail = asyncdata + szBuffer;
+    while (buff != tail)
+        buff = fillWS2811(buff, tail, o, gamma);
+}
+
+/*
+* One GECE packet as PixelDriver::show() built it with the GECE_* masks, bit
+* by bit into pbuff. packet carries over from the last pixel, as it did.
+*/
+inline void gecePacket(uint8_t *pbuff, uint32_t &packet, uint8_t i,
+        const uint8_t *pixdata) {
+    packet = (packet & ~GECE_ADDRESS_MASK) | (i << 20);
+    packet = (packet & ~GECE_BRIGHTNESS_MASK) |
+            (GECE_DEFAULT_BRIGHTNESS << 12);
+    packet = (packet & ~GECE_BLUE_MASK) | (pixdata[i*3+2] << 4);
+    packet = (packet & ~GECE_GREEN_MASK) | pixdata[i*3+1];
+    packet = (packet & ~GECE_RED_MASK) | (pixdata[i*3] >> 4);
+
+    uint8_t shift = GECE_PSIZE;
+    for (uint8_t i = 0; i < GECE_PSIZE; i++)
+        pbuff[i] = LOOKUP_GECE[(packet >> --shift) & 0x1];
+}
+
+/* updateGammaTable(), one table from pow() per level */
+inline void gammaTable(uint8_t *table, float gammaVal, float briteVal) {
+    for (int i = 0; i < 256; i++) {
+        table[i] = (uint8_t) min((255.0 * pow(i * briteVal / 255.0, gammaVal) + 0.5), 255.0);
+    }
+}
+
+}  // namespace baseline
+
+#endif /* BASELINE_H_ */
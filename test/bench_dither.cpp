@@ -0,0 +1,40 @@
+/*
+* bench_dither.cpp - show() cost of a 1360 pixel WS2811 frame with and
+* without temporal dithering. Host timings, so only the ratio means anything.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+
+#define PIXELS  1360
+#define FRAMES  2000
+
+PixelDriver pixels;
+
+static double bench(bool dither) {
+    pixels.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixels.setDither(dither);
+    for (uint16_t i = 0; i < PIXELS * 3; i++)
+        pixels.setValue(i, rand());
+    pixels.commit();
+
+    host_record = false;
+    double t = host_time([] {
+        pixels.show();
+        host_uart(UART1);
+    }, FRAMES);
+    host_record = true;
+    return t * 1e6;
+}
+
+int main() {
+    updateGammaTable(2.2, 0.25);
+    srand(1);
+
+    double plain = bench(false);
+    double dithered = bench(true);
+    printf("%u pixels, per frame: 8 bit %.1fus, dithered %.1fus (%.2fx)\n",
+            PIXELS, plain, dithered, dithered / plain);
+
+    return host_result("bench_dither");
+}
@@ -0,0 +1,95 @@
+/*
+* bench_interp.cpp - Cost of interpolating a 1360 pixel WS2811 string: the
+* fixed point blend in show() halfway between two 10 fps input frames (the
+* string itself only refreshes at ~24 fps, so 25 fps isn't blended), and
+* the snapshot commit() takes of each input frame. Host timings, so only
+* the ratios mean anything.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+
+#define PIXELS  1360
+#define FRAMES  2000
+#define TFRAME  100000  /* 10 fps input */
+
+PixelDriver pixels;
+
+/* A fade step, small enough that it isn't cut as a jump */
+static void setFrame(uint8_t step) {
+    for (uint16_t i = 0; i < PIXELS * 3; i++)
+        pixels.setValue(i, (i & 0xF) * 15 + step);
+}
+
+/* Two committed frames TFRAME apart, time left halfway through the blend */
+static uint32_t start(bool interpolate) {
+    pixels.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixels.setInterpolate(interpolate);
+    host_us = 0;
+    setFrame(0);
+    pixels.commit();
+    host_us += TFRAME;
+    setFrame(10);
+    pixels.commit();
+    uint32_t mid = host_us + TFRAME / 2;
+
+    /*
+    * Every pass has to send the whole string, or there's nothing to time,
+    * and halfway through has to differ from the end when blending.
+    */
+    std::vector<uint8_t> sent[2];
+    for (uint8_t i = 0; i < 2; i++) {
+        host_fifo[UART1].clear();
+        host_us = mid + i * TFRAME / 2;
+        pixels.show();
+        host_uart(UART1);
+        sent[i] = host_fifo[UART1];
+        CHECK(sent[i].size() == PIXELS * 3 * WS2811_SYMBOLS,
+                "%s: %zu bytes sent", interpolate ? "blended" : "as is",
+                sent[i].size());
+    }
+    CHECK((sent[0] != sent[1]) == interpolate, "%s halfway",
+            interpolate ? "not blended" : "blended");
+    return mid;
+}
+
+static double benchShow(bool interpolate) {
+    uint32_t mid = start(interpolate);
+
+    host_record = false;
+    double t = host_time([mid] {
+        host_us = mid;
+        pixels.show();
+        host_uart(UART1);
+    }, FRAMES);
+    host_record = true;
+    return t * 1e6;
+}
+
+static double benchCommit(bool interpolate) {
+    uint32_t mid = start(interpolate);
+
+    uint8_t val = 0;
+    double t = host_time([mid, &val] {
+        host_us = mid;
+        pixels.setValue(0, val++);
+        pixels.commit();
+    }, FRAMES);
+    return t * 1e6;
+}
+
+int main() {
+    updateGammaTable(2.2, 0.25);
+
+    double plain = benchShow(false);
+    double blended = benchShow(true);
+    printf("%u pixels, show(): as is %.1fus, blended %.1fus (%.2fx)\n",
+            PIXELS, plain, blended, blended / plain);
+
+    double commit = benchCommit(false);
+    double snapshot = benchCommit(true);
+    printf("%u pixels, commit(): %.2fus, with snapshot %.1fus\n",
+            PIXELS, commit, snapshot);
+
+    return host_result("bench_interp");
+}
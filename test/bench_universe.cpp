@@ -0,0 +1,138 @@
+/*
+* bench_universe.cpp - Per packet cost of getting E1.31 data into the pixel
+* buffer: the offsets loop() used to work out for every packet and a
+* setValue() per slot, against a lookup in the universe table and one
+* setValues(). Host timings, so only the ratios mean anything.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+
+#define LIMIT   510     /* Slots used per universe, 170 pixels */
+#define SLOTS   512     /* Slots in each packet */
+#define FRAMES  2000
+
+PixelDriver pixels[2];
+
+/* universe_map_t from ESPixelStick.h, which needs the whole sketch */
+typedef struct {
+    uint16_t    src;            /* First slot used, 0 based */
+    uint16_t    dst;            /* Output channel it goes to */
+    uint16_t    len;            /* Slots used */
+} universe_map_t;
+
+/* loop() before the table, for universe uniOffset */
+static void setOld(PixelDriver &out, uint8_t uniOffset, const uint8_t *data,
+        uint16_t start, uint16_t count) {
+    // Offset the channels if required
+    uint16_t offset = 0;
+    offset = start - 1;
+
+    // Find start of data based off the Universe
+    int16_t dataStart = uniOffset * LIMIT - offset;
+
+    // Calculate how much data we need for this buffer
+    uint16_t dataStop = count;
+    uint16_t channels = SLOTS;
+    if (LIMIT < channels)
+        channels = LIMIT;
+    if ((dataStart + channels) < dataStop)
+        dataStop = dataStart + channels;
+
+    // Set the data
+    uint16_t buffloc = 0;
+
+    // ignore data from start of first Universe before channel_start
+    if (dataStart < 0) {
+        dataStart = 0;
+        buffloc = start - 1;
+    }
+
+    for (int i = dataStart; i < dataStop; i++) {
+        out.setValue(i, data[buffloc]);
+        buffloc++;
+    }
+}
+
+/* The table as updateConfig() builds it */
+static void buildMap(universe_map_t *uniMap, uint8_t uniTotal, uint16_t start,
+        uint16_t chanLast) {
+    for (uint8_t i = 0; i < uniTotal; i++) {
+        int32_t first = i * LIMIT - (start - 1);
+        uniMap[i].src = first < 0 ? -first : 0;
+        uniMap[i].dst = first < 0 ? 0 : first;
+        uniMap[i].len = 0;
+        if (uniMap[i].dst < chanLast)
+            uniMap[i].len = std::min<int32_t>(LIMIT - uniMap[i].src,
+                    chanLast - uniMap[i].dst);
+    }
+}
+
+/* loop() now */
+static void setNew(PixelDriver &out, const universe_map_t &map,
+        const uint8_t *data) {
+    uint16_t slots = SLOTS;
+    if (slots > map.src)
+        out.setValues(map.dst, data + map.src,
+                std::min<uint16_t>(map.len, slots - map.src));
+}
+
+static std::vector<uint8_t> sent(PixelDriver &out) {
+    out.commit();
+    host_fifo[UART1].clear();
+    out.show();
+    host_uart(UART1);
+    return host_fifo[UART1];
+}
+
+static void bench(uint8_t uniTotal, uint16_t start) {
+    uint16_t count = uniTotal * LIMIT - (start - 1);
+    count -= count % 3;
+    universe_map_t uniMap[8];
+    buildMap(uniMap, uniTotal, start, count);
+
+    // Two frames to alternate between, so every packet changes every slot
+    static uint8_t data[2][8][SLOTS];
+    for (uint8_t f = 0; f < 2; f++)
+        for (uint8_t u = 0; u < uniTotal; u++)
+            for (uint16_t i = 0; i < SLOTS; i++)
+                data[f][u][i] = rand();
+
+    for (PixelDriver &out : pixels)
+        out.begin(PixelType::WS2811, PixelColor::RGB, count / 3);
+    for (uint8_t f = 0; f < 2; f++) {
+        for (uint8_t u = 0; u < uniTotal; u++) {
+            setOld(pixels[0], u, data[f][u], start, count);
+            setNew(pixels[1], uniMap[u], data[f][u]);
+        }
+        CHECK(sent(pixels[0]) == sent(pixels[1]),
+                "%u universes from %u: frame %u differs", uniTotal, start, f);
+    }
+
+    uint8_t f = 0;
+    double old = host_time([&] {
+        f ^= 1;
+        for (uint8_t u = 0; u < uniTotal; u++)
+            setOld(pixels[0], u, data[f][u], start, count);
+    }, FRAMES);
+    double now = host_time([&] {
+        f ^= 1;
+        for (uint8_t u = 0; u < uniTotal; u++)
+            setNew(pixels[1], uniMap[u], data[f][u]);
+    }, FRAMES);
+
+    old *= 1e6 / uniTotal;
+    now *= 1e6 / uniTotal;
+    printf("%u universes from %3u, per packet: setValue() %.2fus, "
+            "table %.2fus (%.1fx)\n", uniTotal, start, old, now, old / now);
+}
+
+int main() {
+    srand(1);
+    for (uint8_t uniTotal = 1; uniTotal <= 8; uniTotal++)
+        for (uint16_t start : {1, 4, 100, 511})
+            if (uniTotal * LIMIT > start + 2)
+                bench(uniTotal, start);
+
+    return host_result("bench_universe");
+}
@@ -0,0 +1,83 @@
+/*
+* bench_ws2811.cpp - Cost of a 1360 pixel WS2811 frame, split into the work
+* done in show() and the work done in the TX FIFO interrupt, for the old
+* encode-in-the-ISR path and the pre-encoded one. Host timings, so only the
+* ratios mean anything.
+*/
+
+#include "host.h"
+#include "baseline.h"
+
+#define PIXELS  1360
+#define FRAMES  2000
+
+PixelDriver pixels;
+uint8_t pixdata[PIXELS * 3];
+uint8_t asyncdata[PIXELS * 3];
+
+typedef std::chrono::steady_clock Clock;
+
+static double us(Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+static void bench(const char *name, uint16_t group, uint16_t zigzag) {
+    pixels.begin(PixelType::WS2811, PixelColor::GRB, PIXELS);
+    pixels.setGroup(group, zigzag);
+    pixels.setValues(0, pixdata, sizeof(pixdata));
+    pixels.commit();
+
+    baseline::Order o = baseline::order(PixelColor::GRB);
+    Clock::duration oldShow{}, oldIsr{}, newShow{}, newIsr{};
+    std::vector<uint8_t> oldOut, newOut;
+    for (uint16_t f = 0; f < FRAMES; f++) {
+        // Keep the first frame of each to compare, then just hit the register
+        host_record = !f;
+        host_fifo[UART1].clear();
+        Clock::time_point t0 = Clock::now();
+        baseline::layout(pixdata, asyncdata, sizeof(pixdata), group, zigzag);
+        Clock::time_point t1 = Clock::now();
+        const uint8_t *buff = asyncdata;
+        const uint8_t *tail = asyncdata + sizeof(asyncdata);
+        while (buff != tail)
+            buff = baseline::fillWS2811(buff, tail, o, GAMMA_TABLE[0]);
+        Clock::time_point t2 = Clock::now();
+        oldShow += t1 - t0;
+        oldIsr += t2 - t1;
+        if (!f)
+            oldOut = host_fifo[UART1];
+
+        host_fifo[UART1].clear();
+        pixels.setFullRefresh(0);
+        t0 = Clock::now();
+        pixels.show();
+        t1 = Clock::now();
+        host_uart(UART1);
+        t2 = Clock::now();
+        newShow += t1 - t0;
+        newIsr += t2 - t1;
+        if (!f)
+            newOut = host_fifo[UART1];
+    }
+
+    host_record = true;
+    CHECK(oldOut == newOut, "%s: output differs", name);
+    printf("%-16s old show %7.1fus isr %7.1fus | new show %7.1fus isr %7.1fus\n",
+            name, us(oldShow) / FRAMES, us(oldIsr) / FRAMES,
+            us(newShow) / FRAMES, us(newIsr) / FRAMES);
+}
+
+int main() {
+    updateGammaTable(2.2, 1.0);
+    srand(1);
+    for (uint16_t i = 0; i < sizeof(pixdata); i++)
+        pixdata[i] = rand();
+
+    printf("%u pixels, per frame\n", PIXELS);
+    bench("1:1", 1, 0);
+    bench("group 3", 3, 0);
+    bench("zigzag 17", 1, 17);
+    bench("group 2 zz 7", 2, 7);
+
+    return host_result("bench_ws2811");
+}
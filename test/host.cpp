@@ -0,0 +1,102 @@
+/*
+* host.cpp - Host side harness for the driver tests, see host.h
+*/
+
+#include "host.h"
+#include <SPI.h>
+
+volatile uint32_t REGS[4096];
+uint32_t host_us;
+std::vector<uint8_t> host_fifo[2];
+bool host_record = true;
+std::vector<uint8_t> host_spi;
+int host_failures;
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+SPIClass SPI;
+
+static void (*uart_handler)(void *);
+static void *uart_arg;
+static timercallback timer1_handler;
+static bool timer1_on;
+static uint32_t timer1_ticks;
+
+uint32_t micros() { return host_us; }
+uint32_t millis() { return host_us / 1000; }
+void delay(unsigned long ms) { host_us += ms * 1000; }
+void delayMicroseconds(unsigned int us) { host_us += us; }
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+void timer1_isr_init() {}
+void timer1_attachInterrupt(timercallback userFunc) { timer1_handler = userFunc; }
+void timer1_detachInterrupt() { timer1_handler = nullptr; }
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload) {
+    timer1_on = true;
+}
+void timer1_disable() { timer1_on = false; }
+void timer1_write(uint32_t ticks) { timer1_ticks = ticks; }
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--)
+        n += write(*buffer++);
+    return n;
+}
+size_t Print::print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+size_t Print::print(int n) { return printf("%d", n); }
+size_t Print::println(const char *s) { return print(s) + write('\n'); }
+size_t Print::println(int n) { return print(n) + write('\n'); }
+
+void HardwareSerial::begin(unsigned long baud, int config, int mode) {
+    this->baud = baud;
+    this->config = config;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    host_fifo[uart & 1].push_back(c);
+    return 1;
+}
+
+void host_push(uint8_t uart, uint8_t byte) {
+    host_fifo[uart & 1].push_back(byte);
+}
+
+void SPIClass::writeBytes(const uint8_t *data, uint32_t size) {
+    host_spi.insert(host_spi.end(), data, data + size);
+}
+
+void host_uart_attach(void (*handler)(void *), void *arg) {
+    uart_handler = handler;
+    uart_arg = arg;
+}
+
+/* The FIFO always reads as empty, so each pass takes a full FIFO's worth */
+void host_uart(uint8_t uart) {
+    while (uart_handler &&
+            (READ_PERI_REG(UART_INT_ENA(uart)) & UART_TXFIFO_EMPTY_INT_ENA)) {
+        WRITE_PERI_REG(UART_INT_ST(uart), UART_TXFIFO_EMPTY_INT_ENA);
+        uart_handler(uart_arg);
+        host_us += 40;
+    }
+    WRITE_PERI_REG(UART_INT_ST(uart), 0);
+}
+
+/* timer1 runs at 80MHz / 16 for every user here, 5 ticks per microsecond */
+void host_timer1() {
+    while (host_timer1_once()) {}
+}
+
+bool host_timer1_once() {
+    if (!timer1_on || !timer1_handler)
+        return false;
+    host_us += timer1_ticks / 5;
+    timer1_handler();
+    return true;
+}
+
+int host_result(const char *name) {
+    printf("%s: %s\n", name, host_failures ? "FAIL" : "ok");
+    return host_failures ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+/*
+* host.h - Host side harness for the driver tests
+*
+* The stubs in stub/ stand in for the ESP8266 core. Time only moves when a
+* test moves it, and the UART / timer1 handlers the drivers attach are run
+* from here, so a test can play out a whole frame and look at what went on
+* the wire.
+*/
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <Arduino.h>
+#include <uart_register.h>
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+
+extern uint32_t host_us;                    // What micros() returns
+extern std::vector<uint8_t> host_fifo[2];   // Bytes written to each TX FIFO
+extern bool host_record;                    // Record FIFO bytes, else just write them
+extern std::vector<uint8_t> host_spi;       // Bytes written to the SPI bus
+extern int host_failures;
+
+/* Run the UART handler until uart's TX interrupt is switched off */
+void host_uart(uint8_t uart);
+
+/* Run the timer1 handler until it disables the timer, advancing time */
+void host_timer1();
+
+/* Run the next timer1 interrupt only, false if none is armed */
+bool host_timer1_once();
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        host_failures++; \
+        printf("%s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+/* Exit status for main(), prints the verdict */
+int host_result(const char *name);
+
+/* Seconds per iteration of fn, for the benchmarks */
+template <typename F>
+double host_time(F fn, uint32_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+        fn();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count() / iterations;
+}
+
+#endif /* HOST_H_ */
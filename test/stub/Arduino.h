@@ -0,0 +1,176 @@
+/*
+* Arduino.h - Host stand-in for the ESP8266 core, just enough to build the
+* output drivers for the tests in test/. Registers are a flat array, the
+* UART TX FIFOs and the SPI bus record what is written to them, see host.h.
+*/
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define F(x) x
+#define F_CPU           160000000L
+
+#define INPUT           0x00
+#define OUTPUT          0x01
+#define FUNCTION_1      0x08
+#define LOW             0
+#define HIGH            1
+
+#define SERIAL_6N1      0x11
+#define SERIAL_7N1      0x15
+#define SERIAL_8N1      0x1c
+#define SERIAL_8N2      0x3c
+#define SERIAL_FULL     0
+#define SERIAL_TX_ONLY  2
+
+#define constrain(amt, low, high) \
+        ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define noInterrupts()  do {} while (0)
+#define interrupts()    do {} while (0)
+
+uint32_t micros();
+uint32_t millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+/* timer1 */
+typedef void (*timercallback)(void);
+#define TIM_DIV1        0
+#define TIM_DIV16       1
+#define TIM_DIV256      3
+#define TIM_EDGE        0
+#define TIM_SINGLE      0
+#define TIM_LOOP        1
+void timer1_isr_init();
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_detachInterrupt();
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable();
+void timer1_write(uint32_t ticks);
+
+class Print {
+ public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *s);
+    size_t print(int n);
+    size_t println(const char *s = "");
+    size_t println(int n);
+};
+
+class Stream : public Print {
+ public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+#include "HardwareSerial.h"
+
+/* Peripheral registers, indexed by the low 12 bits of the address */
+extern volatile uint32_t REGS[4096];
+#define ESP8266_REG(addr)   REGS[(addr) & 0xFFF]
+
+/*
+* TX FIFO writes are recorded per UART instead of landing in a register, or
+* for the benchmarks just stored, see host.h.
+*/
+extern bool host_record;
+void host_push(uint8_t uart, uint8_t byte);
+
+struct HostFifo {
+    uint8_t uart;
+    inline void operator=(uint32_t byte) const {
+        if (host_record)
+            host_push(uart, byte);
+        else
+            ESP8266_REG(0xF00 * (uart & 1)) = byte;
+    }
+};
+
+#define USF(u)          (HostFifo{static_cast<uint8_t>(u)})
+#define USS(u)          ESP8266_REG(0x01C + 0xF00 * ((u) & 1))
+#define USTXC           16
+
+/* I2S */
+#define I2SC            ESP8266_REG(0xE08)
+#define I2SIE           ESP8266_REG(0xE14)
+#define I2SIC           ESP8266_REG(0xE18)
+#define I2SFC           ESP8266_REG(0xE20)
+#define I2SCC           ESP8266_REG(0xE2C)
+#define I2SRST          0
+#define I2SRF           1
+#define I2SMR           2
+#define I2SRMS          3
+#define I2STMS          4
+#define I2STSM          5
+#define I2SRSM          6
+#define I2STXR          7
+#define I2STXS          8
+#define I2SBMM          0xF
+#define I2SBM           12
+#define I2SBDM          0x3F
+#define I2SBD           16
+#define I2SCDM          0x3F
+#define I2SCD           22
+#define I2SDE           12
+#define I2STXFMM        7
+#define I2STXFM         13
+#define I2SRXFMM        7
+#define I2SRXFM         16
+#define I2STXCMM        7
+#define I2STXCM         0
+#define I2SRXCMM        3
+#define I2SRXCM         3
+
+/* SLC DMA */
+#define SLCC0           ESP8266_REG(0xB00)
+#define SLCIS           ESP8266_REG(0xB08)
+#define SLCIE           ESP8266_REG(0xB0C)
+#define SLCIC           ESP8266_REG(0xB10)
+#define SLCRXL          ESP8266_REG(0xB34)
+#define SLCTXL          ESP8266_REG(0xB40)
+#define SLCRXEOFA       ESP8266_REG(0xB54)
+#define SLCRXDC         ESP8266_REG(0xB94)
+#define SLCRXLR         0
+#define SLCTXLR         1
+#define SLCMM           3
+#define SLCM            12
+#define SLCBTNR         9
+#define SLCBINR         10
+#define SLCIRXEOF       17
+#define SLCBRXFM        18
+#define SLCBRXEM        19
+#define SLCBRXFE        20
+#define SLCRXLAM        0xFFFFF
+#define SLCRXLA         0
+#define SLCRXLE         28
+#define SLCRXLS         29
+#define SLCTXLAM        0xFFFFF
+#define SLCTXLA         0
+#define SLCTXLS         29
+
+#define ETS_SLC_INTR_ATTACH(func, arg)  (void)0
+#define ETS_SLC_INTR_ENABLE()           (void)0
+#define ETS_SLC_INTR_DISABLE()          (void)0
+
+#endif /* HOST_ARDUINO_H_ */
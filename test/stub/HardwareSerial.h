@@ -0,0 +1,28 @@
+#ifndef HOST_HARDWARESERIAL_H_
+#define HOST_HARDWARESERIAL_H_
+
+#include "Arduino.h"
+
+/* Only configures the port, the drivers fill the FIFOs themselves */
+class HardwareSerial : public Stream {
+ public:
+    explicit HardwareSerial(int uart) : uart(uart) {}
+    void begin(unsigned long baud, int config = SERIAL_8N1,
+            int mode = SERIAL_FULL);
+    void end() {}
+    void flush() {}
+    size_t write(uint8_t c) override;
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    int             uart;
+    unsigned long   baud;       // Last begin()
+    int             config;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif /* HOST_HARDWARESERIAL_H_ */
@@ -0,0 +1,24 @@
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include "Arduino.h"
+
+#define SPI_MODE0       0x00
+#define MSBFIRST        1
+
+/* Records the bytes written, see host.h */
+class SPIClass {
+ public:
+    void begin() {}
+    void end() {}
+    void setDataMode(uint8_t mode) {}
+    void setBitOrder(uint8_t order) {}
+    void setFrequency(uint32_t freq) { this->freq = freq; }
+    void writeBytes(const uint8_t *data, uint32_t size);
+
+    uint32_t    freq;
+};
+
+extern SPIClass SPI;
+
+#endif /* HOST_SPI_H_ */
@@ -0,0 +1 @@
+/* Nothing needed on the host, see Arduino.h and uart_register.h */
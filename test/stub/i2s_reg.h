@@ -0,0 +1,6 @@
+#ifndef HOST_I2S_REG_H_
+#define HOST_I2S_REG_H_
+
+#define I2S_CLK_ENABLE()    (void)0
+
+#endif /* HOST_I2S_REG_H_ */
@@ -0,0 +1,37 @@
+#ifndef HOST_UART_REGISTER_H_
+#define HOST_UART_REGISTER_H_
+
+#include "Arduino.h"
+
+#define BIT(n)                      (1UL << (n))
+#define READ_PERI_REG(addr)         ESP8266_REG(addr)
+#define WRITE_PERI_REG(addr, val)   (ESP8266_REG(addr) = (val))
+#define SET_PERI_REG_MASK(addr, m)  (ESP8266_REG(addr) |= (m))
+#define CLEAR_PERI_REG_MASK(addr, m) (ESP8266_REG(addr) &= ~(m))
+
+#define UART0                       0
+#define UART1                       1
+#define UART_TX_FIFO_SIZE           128
+
+#define UART_INT_ST(i)              (0x008 + (i) * 0xF00)
+#define UART_INT_ENA(i)             (0x00C + (i) * 0xF00)
+#define UART_INT_CLR(i)             (0x010 + (i) * 0xF00)
+#define UART_CLKDIV(i)              (0x014 + (i) * 0xF00)
+#define UART_CONF0(i)               (0x020 + (i) * 0xF00)
+#define UART_CONF1(i)               (0x024 + (i) * 0xF00)
+
+#define UART_RXFIFO_FULL_INT_ENA    BIT(0)
+#define UART_TXFIFO_EMPTY_INT_ENA   BIT(1)
+#define UART_TXD_BRK                BIT(8)
+#define UART_RXFIFO_RST             BIT(17)
+#define UART_TXFIFO_RST             BIT(18)
+#define UART_TXFIFO_EMPTY_THRHD_S   8
+
+/* The UART handler is kept so host_uart() can play the interrupt */
+extern "C" void host_uart_attach(void (*handler)(void *), void *arg);
+
+#define ETS_UART_INTR_ATTACH(func, arg) host_uart_attach((func), (arg))
+#define ETS_UART_INTR_ENABLE()          (void)0
+#define ETS_UART_INTR_DISABLE()         (void)0
+
+#endif /* HOST_UART_REGISTER_H_ */
@@ -0,0 +1,63 @@
+/*
+* test_dither.cpp - Over N frames the dithered 8 bit output has to average
+* out to the 16 bit gamma target within 1/N, at every input level.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+
+#define FRAMES  256
+#define PIXELS  86      // 258 subpixels, one per input level and then some
+
+PixelDriver pixels;
+
+/* 2 data bits back out of a 6N1 symbol */
+static uint8_t bitsOf(uint8_t sym) {
+    for (uint8_t b = 0; b < 4; b++)
+        if (static_cast<uint8_t>(LOOKUP_2811[b]) == sym)
+            return b;
+    CHECK(false, "bad symbol 0x%02x", sym);
+    return 0;
+}
+
+int main() {
+    // Low brightness, where 8 bits run out and fades step
+    updateGammaTable(2.2, 0.25);
+
+    pixels.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixels.setDither(true);
+    for (uint16_t i = 0; i < PIXELS * 3; i++)
+        pixels.setValue(i, i);
+    pixels.commit();
+
+    uint32_t sum[PIXELS * 3] = { 0 };
+    for (uint16_t f = 0; f < FRAMES; f++) {
+        host_fifo[UART1].clear();
+        pixels.show();
+        host_uart(UART1);
+        CHECK(host_fifo[UART1].size() == PIXELS * 3 * WS2811_SYMBOLS,
+                "frame %u is %zu bytes", f, host_fifo[UART1].size());
+
+        const uint8_t *sym = host_fifo[UART1].data();
+        for (uint16_t i = 0; i < PIXELS * 3; i++) {
+            uint8_t val = 0;
+            for (uint8_t s = 0; s < WS2811_SYMBOLS; s++)
+                val = (val << 2) | bitsOf(*sym++);
+            sum[i] += val;
+        }
+    }
+
+    uint16_t dithered = 0;
+    for (uint16_t i = 0; i < PIXELS * 3; i++) {
+        uint16_t target = GAMMA_TABLE16[i % 3][i & 0xFF];
+        double mean = static_cast<double>(sum[i]) / FRAMES;
+        double want = target / 256.0;
+        CHECK(fabs(mean - want) <= 1.0 / FRAMES,
+                "level %u: mean %.5f, target %.5f", i & 0xFF, mean, want);
+        if (target & 0xFF)
+            dithered++;
+    }
+    CHECK(dithered > 200, "only %u levels between 8 bit codes", dithered);
+
+    return host_result("test_dither");
+}
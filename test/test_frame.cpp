@@ -0,0 +1,309 @@
+/*
+* test_frame.cpp - Only committed frames reach the wire. The driver under
+* test runs in lockstep with a reference on the other UART that never sees
+* the next frame until it's committed. Every refresh service() sends on
+* its own (dithering, blending, power ramp, full refresh, fades) has to
+* match the reference byte for byte while half of the next frame sits in
+* the receive buffer.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+#include "SerialDriver.h"
+#include "FrameAssembler.h"
+
+#define PIXELS  24
+#define SLOTS   64
+#define STEPS   20
+#define TSTEP   5000    /* us between service() calls */
+
+PixelDriver pixels(UART1);
+PixelDriver pixRef(UART0);
+SerialDriver serial(UART1);
+SerialDriver serRef(UART0);
+
+enum class Mode { FULL, DITHER, BLEND, POWER };
+static const char *modeName[] = { "full refresh", "dither", "blend", "power" };
+
+/* Frames a fade step apart, so they're blended */
+static uint8_t frameValue(uint8_t frame, uint16_t ch) {
+    return frame * 37 + ch * 13;
+}
+
+/*
+* One service() on both and the string / port run dry. Returns what the
+* driver under test sent, which has to be what the reference sent.
+*/
+template <typename D>
+static std::vector<uint8_t> step(D &dut, D &ref, const char *what,
+        uint8_t at) {
+    host_fifo[UART0].clear();
+    host_fifo[UART1].clear();
+    dut.service();
+    ref.service();
+    host_timer1();
+    host_uart(UART1);
+    host_uart(UART0);
+    CHECK(host_fifo[UART1] == host_fifo[UART0], "%s: step %u differs",
+            what, at);
+    host_us += TSTEP;
+    return host_fifo[UART1];
+}
+
+static void setPixels(PixelDriver &out, uint8_t frame, uint16_t first,
+        uint16_t end) {
+    for (uint16_t ch = first; ch < end; ch++)
+        out.setValue(ch, frameValue(frame, ch));
+}
+
+static void startPixels(PixelDriver &out, Mode mode) {
+    out.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    out.setFullRefresh(mode == Mode::FULL ? 0 : 60000);
+    out.setDither(mode == Mode::DITHER);
+    out.setInterpolate(mode == Mode::BLEND);
+    out.setPowerLimit(mode == Mode::POWER ? 50 : 0, 20);
+}
+
+static void checkPixels(Mode mode) {
+    const char *what = modeName[static_cast<uint8_t>(mode)];
+    startPixels(pixels, mode);
+    startPixels(pixRef, mode);
+    host_us = 1000000;
+
+    // Start the limiter well down, so it ramps up from here
+    if (mode == Mode::POWER) {
+        for (PixelDriver *out : { &pixels, &pixRef }) {
+            for (uint16_t ch = 0; ch < PIXELS * 3; ch++)
+                out->setValue(ch, 255);
+            out->commit();
+        }
+        step(pixels, pixRef, what, 0);
+    }
+
+    // Frame 0 goes out, frame 1 is committed and starts blending / ramping
+    for (uint8_t f = 0; f < 2; f++) {
+        setPixels(pixels, f, 0, PIXELS * 3);
+        setPixels(pixRef, f, 0, PIXELS * 3);
+        pixels.commit();
+        pixRef.commit();
+        step(pixels, pixRef, what, 0);
+        host_us += f ? 0 : 50000;
+    }
+
+    // Half of frame 2 arrives, the driver keeps refreshing on its own
+    setPixels(pixels, 2, 0, PIXELS * 3 / 2);
+    uint8_t sent = 0;
+    for (uint8_t s = 0; s < STEPS; s++)
+        sent += !step(pixels, pixRef, what, s).empty();
+    CHECK(sent, "%s: nothing refreshed while waiting", what);
+
+    // The rest of frame 2 and the commit
+    setPixels(pixels, 2, PIXELS * 3 / 2, PIXELS * 3);
+    setPixels(pixRef, 2, 0, PIXELS * 3);
+    pixels.commit();
+    pixRef.commit();
+    for (uint8_t s = 0; s < STEPS; s++)
+        step(pixels, pixRef, what, STEPS + s);
+}
+
+/*
+* A frame committed while the string is still busy waits in the driver.
+* The next frame starting to arrive in that time mustn't join it.
+*/
+static void checkPending() {
+    pixels.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixRef.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixels.setFullRefresh(60000);
+    pixRef.setFullRefresh(60000);
+    step(pixels, pixRef, "pending", 0);
+
+    setPixels(pixels, 0, 0, PIXELS * 3);
+    setPixels(pixRef, 0, 0, PIXELS * 3);
+    pixels.commit();
+    pixRef.commit();
+    pixels.service();
+    pixRef.service();
+    CHECK(pixels.isBusy(), "frame 0 not going out");
+
+    setPixels(pixels, 1, 0, PIXELS * 3);
+    setPixels(pixRef, 1, 0, PIXELS * 3);
+    pixels.commit();
+    pixRef.commit();
+    setPixels(pixels, 2, 0, PIXELS);
+
+    host_uart(UART1);
+    host_uart(UART0);
+    host_us += TSTEP;
+    CHECK(!step(pixels, pixRef, "pending", 1).empty(), "frame 1 not sent");
+    CHECK(pixels.stats.late == 1, "%u frames late", pixels.stats.late);
+}
+
+/* What ddpData() does with a packet */
+FrameAssembler ddpFrame;
+
+static void commitFrame() {
+    pixels.commit(true);
+}
+
+static void ddpPacket(uint8_t frame, uint16_t first, uint16_t end, bool push) {
+    ddpFrame.add(first, end - first);
+    setPixels(pixels, frame, first, end);
+    ddpFrame.written();
+    if (push)
+        ddpFrame.end();
+}
+
+/* What loop() does, the reference only ever sees whole frames */
+static std::vector<uint8_t> ddpLoop(const char *what, uint8_t frame) {
+    if (!ddpFrame.pending())
+        pixels.commit(true);
+    setPixels(pixRef, frame, 0, PIXELS * 3);
+    pixRef.commit(true);
+    host_us += 50000;
+    return step(pixels, pixRef, what, frame);
+}
+
+/*
+* A frame is committed the moment it's presented, so a packet of the next
+* frame arriving before loop() runs stays out of it. Covers the PUSH, a
+* lost PUSH (the next frame's packet overlapping) and a late packet
+* completing a frame whose PUSH went by.
+*/
+static void checkAssembler() {
+    const char *what = "assembler";
+    pixels.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixRef.begin(PixelType::WS2811, PixelColor::RGB, PIXELS);
+    pixels.setFullRefresh(60000);
+    pixRef.setFullRefresh(60000);
+    ddpFrame.begin(100, commitFrame);
+    host_us = 1000000;
+    step(pixels, pixRef, what, 0);
+
+    const uint16_t half = PIXELS * 3 / 2;
+    const uint16_t all = PIXELS * 3;
+
+    // PUSH, then the next frame's first packet
+    ddpPacket(1, 0, half, false);
+    ddpPacket(1, half, all, true);
+    ddpPacket(2, 0, half, false);
+    CHECK(!ddpLoop(what, 1).empty(), "frame 1 not sent");
+
+    // No PUSH, the overlap hands frame 2 over before frame 3 is written
+    ddpPacket(2, half, all, false);
+    ddpPacket(3, 0, half, false);
+    CHECK(!ddpLoop(what, 2).empty(), "frame 2 not sent");
+
+    // PUSH before the rest, which completes it late
+    ddpPacket(3, half, all, false);
+    ddpPacket(4, half, all, true);
+    ddpPacket(4, 0, half, false);
+    ddpPacket(5, 0, half, false);
+    CHECK(!ddpLoop(what, 4).empty(), "frame 4 not sent");
+
+    CHECK(ddpFrame.stats.presented == 4 && ddpFrame.stats.late == 1 &&
+            !ddpFrame.stats.torn, "%u presented, %u late, %u torn",
+            ddpFrame.stats.presented, ddpFrame.stats.late, ddpFrame.stats.torn);
+}
+
+static void setSerial(SerialDriver &out, uint8_t frame, uint16_t first,
+        uint16_t end) {
+    for (uint16_t ch = first; ch < end; ch++)
+        out.setValue(ch, frameValue(frame, ch));
+}
+
+static void startSerial(SerialDriver &out, HardwareSerial &port,
+        SerialType type, bool fade) {
+    out.begin(&port, type, SLOTS, BaudRate::BR_250000);
+    out.setFullRefresh(0);
+    if (fade) {
+        serial_profile_t profiles[] = {
+            { 0, SLOTS / 4, SerialCurve::SQUARE, 0 },
+            { SLOTS / 2, SLOTS / 2, SerialCurve::LINEAR, 50 },
+        };
+        out.setProfiles(profiles, 2);
+    }
+}
+
+static void checkSerial(SerialType type, bool fade) {
+    char what[32];
+    snprintf(what, sizeof(what), "%s%s",
+            type == SerialType::DMX512 ? "DMX" : "Renard",
+            fade ? " fading" : "");
+    startSerial(serial, Serial1, type, fade);
+    startSerial(serRef, Serial, type, fade);
+    host_us = 1000000;
+
+    setSerial(serial, 0, 0, SLOTS);
+    setSerial(serRef, 0, 0, SLOTS);
+    serial.commit();
+    serRef.commit();
+    step(serial, serRef, what, 0);
+
+    // Half of frame 1 arrives while frame 0 refreshes and fades
+    setSerial(serial, 1, 0, SLOTS / 2 + 4);
+    uint8_t sent = 0;
+    for (uint8_t s = 0; s < STEPS; s++)
+        sent += !step(serial, serRef, what, s).empty();
+    CHECK(sent, "%s: nothing refreshed while waiting", what);
+
+    setSerial(serial, 1, SLOTS / 2 + 4, SLOTS);
+    setSerial(serRef, 1, 0, SLOTS);
+    serial.commit();
+    serRef.commit();
+    for (uint8_t s = 0; s < STEPS; s++)
+        step(serial, serRef, what, STEPS + s);
+}
+
+/*
+* The DMX buffers rotate and only catch up on what changed, so random
+* partial frames, with and without a send in between, have to come out as
+* the frame that was committed.
+*/
+static void checkRotation() {
+    serial.begin(&Serial1, SerialType::DMX512, SLOTS, BaudRate::BR_250000);
+    serial.setFullRefresh(0);
+    host_us = 1000000;
+
+    uint8_t want[SLOTS] = {};
+    uint8_t committed[SLOTS] = {};
+    srand(1);
+    for (uint16_t f = 0; f < 500; f++) {
+        uint16_t first = rand() % SLOTS;
+        uint16_t end = first + rand() % (SLOTS - first) + 1;
+        for (uint16_t ch = first; ch < end; ch++) {
+            want[ch] = rand();
+            serial.setValue(ch, want[ch]);
+        }
+        if (rand() % 3) {
+            serial.commit();
+            memcpy(committed, want, SLOTS);
+        }
+        if (rand() % 4 == 0)
+            continue;
+
+        host_fifo[UART1].clear();
+        serial.service();
+        host_timer1();
+        host_uart(UART1);
+        host_us += TSTEP;
+        std::vector<uint8_t> &sent = host_fifo[UART1];
+        CHECK(sent.size() == SLOTS + 1u && !memcmp(&sent[1], committed, SLOTS),
+                "rotation: frame %u isn't the committed one", f);
+    }
+}
+
+int main() {
+    updateGammaTable(2.2, 1.0);
+
+    for (Mode mode : { Mode::FULL, Mode::DITHER, Mode::BLEND, Mode::POWER })
+        checkPixels(mode);
+    checkPending();
+    checkAssembler();
+
+    for (SerialType type : { SerialType::DMX512, SerialType::RENARD })
+        for (bool fade : { false, true })
+            checkSerial(type, fade);
+    checkRotation();
+
+    return host_result("test_frame");
+}
@@ -0,0 +1,79 @@
+/*
+* test_gece.cpp - GECE packets as handleGECE() puts them on the wire,
+* against the packets show() used to build and send inline: same bytes,
+* same start bit and the same start to start spacing. Grouped strings
+* repeat each source pixel, as they do on the other types.
+*/
+
+#include "host.h"
+#include "baseline.h"
+
+PixelDriver pixels;
+
+static bool lineBreak() {
+    return READ_PERI_REG(UART_CONF0(UART)) & UART_TXD_BRK;
+}
+
+static void checkFrame(uint8_t length, uint32_t seed, uint8_t group = 1) {
+    pixels.begin(PixelType::GECE, PixelColor::RGB, length);
+    pixels.setGroup(group, 0);
+    CHECK(Serial1.baud == 300000 && Serial1.config == SERIAL_7N1,
+            "GECE UART %lu baud, config 0x%02x", Serial1.baud, Serial1.config);
+
+    // What each bulb shows, pixdata for the old sender
+    std::vector<uint8_t> pixdata(length * 3);
+    for (uint16_t ch = 0; ch < (length + group - 1) / group * 3; ch++) {
+        seed = seed * 1103515245 + 12345;
+        uint8_t value = seed >> 16;
+        pixels.setValue(ch, value);
+        for (uint8_t g = 0; g < group; g++) {
+            uint16_t bulb = (ch / 3) * group + g;
+            if (bulb < length)
+                pixdata[bulb * 3 + ch % 3] = value;
+        }
+    }
+
+    pixels.commit();
+    host_fifo[UART].clear();
+    pixels.show();
+
+    uint32_t packet = 0;
+    uint8_t pbuff[GECE_PSIZE];
+    uint32_t lastStart = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        // The start bit, line out of break with nothing sent yet
+        CHECK(!lineBreak(), "%u bulbs: no start bit for %u", length, i);
+        CHECK(host_fifo[UART].empty(), "%u bulbs: %zu bytes before %u",
+                length, host_fifo[UART].size(), i);
+        uint32_t start = host_us;
+        if (i)
+            CHECK(start - lastStart == GECE_TFRAME + GECE_TIDLE,
+                    "%u bulbs: %uus between %u and %u", length,
+                    start - lastStart, i - 1, i);
+        lastStart = start;
+
+        // The packet, then break
+        CHECK(host_timer1_once(), "%u bulbs: timer stopped at %u", length, i);
+        CHECK(host_us - start == GECE_TSTART, "%u bulbs: %uus start bit",
+                length, host_us - start);
+        baseline::gecePacket(pbuff, packet, i, pixdata.data());
+        CHECK(host_fifo[UART] == std::vector<uint8_t>(pbuff,
+                pbuff + GECE_PSIZE), "%u bulbs: packet %u differs", length, i);
+        CHECK(lineBreak(), "%u bulbs: no break after %u", length, i);
+        host_fifo[UART].clear();
+
+        if (i + 1 < length)
+            CHECK(host_timer1_once(), "%u bulbs: timer stopped after %u",
+                    length, i);
+    }
+    CHECK(!host_timer1_once(), "%u bulbs: timer still running", length);
+}
+
+int main() {
+    for (uint8_t length : {1, 2, 7, 50, 63})
+        checkFrame(length, length);
+    for (uint8_t group : {2, 3})
+        checkFrame(63, group, group);
+
+    return host_result("test_gece");
+}
@@ -0,0 +1,70 @@
+/*
+* test_i2s.cpp - The WS2811 waveform encodeI2S() puts on the wire, measured
+* in I2S bits at the bit clock i2s_init() sets up, against the WS2811 /
+* WS2812B high speed timing.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+
+PixelDriver pixels;
+
+/* High times and bit period in ns, datasheet values +/- 150ns */
+#define T0H_MIN     250
+#define T0H_MAX     550
+#define T1H_MIN     650
+#define T1H_MAX     950
+#define TBIT_MIN    1100
+#define TBIT_MAX    1400
+
+/* The bit clock i2s_init() left in I2SC, in Hz */
+static double bitClock() {
+    uint32_t bd = (I2SC >> I2SBD) & I2SBDM;
+    uint32_t cd = (I2SC >> I2SCD) & I2SCDM;
+    CHECK(bd && cd, "I2S dividers %u / %u", bd, cd);
+    return bd && cd ? double(F_CPU) / bd / cd : 0;
+}
+
+/*
+* Walk the 32 I2S bits of one subpixel in the order the DMA sends them, MSB
+* of the word first, and decode them as 8 WS2811 bits of 4 I2S bits each.
+*/
+static void checkValue(uint8_t val, double tbit) {
+    uint16_t half[2];
+    CHECK(PixelDriver::encodeI2S(half, val) == half + 2, "encodeI2S length");
+    uint32_t word;
+    memcpy(&word, half, sizeof(word));
+
+    uint8_t got = 0;
+    for (int8_t b = 7; b >= 0; b--) {
+        uint8_t sym = (word >> (b * 4)) & 0xF;
+        uint8_t high = 0;
+        while (high < 4 && (sym & (0x8 >> high)))
+            high++;
+        CHECK(high && (sym << high & 0xF) == 0,
+                "0x%02x bit %d: I2S bits %x aren't high then low", val, b, sym);
+
+        double th = high * tbit;
+        bool one = th >= T1H_MIN && th <= T1H_MAX;
+        bool zero = th >= T0H_MIN && th <= T0H_MAX;
+        CHECK(one || zero, "0x%02x bit %d: %.1fns high", val, b, th);
+        CHECK(one == bool(val & (1 << b)), "0x%02x bit %d: %u I2S bits high",
+                val, b, high);
+        got |= one << b;
+    }
+    CHECK(got == val, "0x%02x decodes as 0x%02x", val, got);
+}
+
+int main() {
+    pixels.begin(PixelType::WS2811_I2S, PixelColor::RGB, 1);
+    double clock = bitClock();
+    CHECK(clock == 3200000, "I2S bit clock %.0fHz", clock);
+
+    double tbit = 1e9 / clock;
+    CHECK(4 * tbit >= TBIT_MIN && 4 * tbit <= TBIT_MAX,
+            "WS2811 bit period %.1fns", 4 * tbit);
+    for (uint16_t val = 0; val < 256; val++)
+        checkValue(val, tbit);
+
+    return host_result("test_i2s");
+}
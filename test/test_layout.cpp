@@ -0,0 +1,67 @@
+/*
+* test_layout.cpp - The group / zigzag source map and the WS2811 encoder
+* against the per-pixel arithmetic and per-subpixel lookups they replaced,
+* for every byte value in every color order and every combination of
+* group size, zigzag size and pixel count up to MAX_PIXELS.
+*/
+
+#include "host.h"
+#include "baseline.h"
+
+#define MAX_PIXELS  48
+
+PixelDriver pixels;
+uint8_t pixdata[MAX_PIXELS * 3];
+uint8_t asyncdata[MAX_PIXELS * 3];
+
+/* One frame through the driver and through the old code */
+static bool same(PixelColor color, uint16_t length, uint16_t group,
+        uint16_t zigzag) {
+    pixels.begin(PixelType::WS2811, color, length);
+    pixels.setGroup(group, zigzag);
+    pixels.setValues(0, pixdata, length * 3);
+
+    pixels.commit();
+    host_fifo[UART1].clear();
+    pixels.show();
+    host_uart(UART1);
+    std::vector<uint8_t> sent = host_fifo[UART1];
+
+    host_fifo[UART1].clear();
+    baseline::showWS2811(pixdata, asyncdata, length * 3, group, zigzag,
+            color, GAMMA_TABLE[0]);
+    return sent == host_fifo[UART1];
+}
+
+int main() {
+    updateGammaTable(2.2, 1.0);
+
+    srand(1);
+    for (uint16_t i = 0; i < sizeof(pixdata); i++)
+        pixdata[i] = rand();
+
+    // Every value in every slot of every color order, no grouping
+    for (uint8_t c = 0; c <= static_cast<uint8_t>(PixelColor::BGR); c++) {
+        PixelColor color = static_cast<PixelColor>(c);
+        for (uint16_t v = 0; v < 256; v++) {
+            for (uint8_t ch = 0; ch < 3; ch++)
+                pixdata[ch] = v;
+            CHECK(same(color, MAX_PIXELS, 1, 0), "color %u value %u", c, v);
+        }
+    }
+
+    // Every layout
+    uint32_t layouts = 0;
+    for (uint16_t length = 1; length <= MAX_PIXELS; length++) {
+        for (uint16_t group = 1; group <= length + 1; group++) {
+            for (uint16_t zigzag = 0; zigzag <= length + 1; zigzag++) {
+                CHECK(same(PixelColor::GRB, length, group, zigzag),
+                        "%u pixels group %u zigzag %u", length, group, zigzag);
+                layouts++;
+            }
+        }
+    }
+    printf("%u layouts\n", layouts);
+
+    return host_result("test_layout");
+}
@@ -0,0 +1,159 @@
+/*
+* test_spi.cpp - Frames the clocked pixel types put on the SPI bus: start
+* frame, per pixel header and bits, and the latch / end frame at lengths
+* either side of where their rounding steps. APA102 / LPD8806 frames go out
+* a chunk per service(), WS2801 in one write at a capped frame rate.
+*/
+
+#include "host.h"
+#include <SPI.h>
+#include "PixelDriver.h"
+
+PixelDriver pixels;
+
+/* Pixel i of a test frame is (i, 2i + 1, 255 - i), sent GRB */
+static void setFrame(uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        pixels.setValue(i * 3 + 0, i);
+        pixels.setValue(i * 3 + 1, i * 2 + 1);
+        pixels.setValue(i * 3 + 2, 255 - i);
+    }
+}
+
+/* The corrected GRB bytes of pixel i */
+static void expectPixel(std::vector<uint8_t> &out, uint16_t i, uint8_t mask,
+        uint8_t shift) {
+    out.push_back(mask | (GAMMA_TABLE[1][(i * 2 + 1) & 0xFF] >> shift));
+    out.push_back(mask | (GAMMA_TABLE[0][i & 0xFF] >> shift));
+    out.push_back(mask | (GAMMA_TABLE[2][(255 - i) & 0xFF] >> shift));
+}
+
+static std::vector<uint8_t> send(PixelType type, uint16_t length,
+        float brightness = 1.0) {
+    pixels.begin(type, PixelColor::GRB, length);
+    pixels.setBrightness(brightness);
+    setFrame(length);
+    pixels.commit();
+    host_spi.clear();
+    pixels.show();
+    while (pixels.isBusy())
+        pixels.service();
+    return host_spi;
+}
+
+static void checkAPA102(uint16_t length) {
+    std::vector<uint8_t> sent = send(PixelType::APA102, length);
+    CHECK(SPI.freq == APA102_CLOCK, "APA102 clock %u", SPI.freq);
+
+    std::vector<uint8_t> want(4, 0x00);
+    for (uint16_t i = 0; i < length; i++) {
+        want.push_back(0xE0 | 31);
+        expectPixel(want, i, 0x00, 0);
+    }
+    want.resize(want.size() + (length + 15) / 16, 0x00);
+    CHECK(sent == want, "APA102 %u pixels: %zu bytes, %zu expected",
+            length, sent.size(), want.size());
+}
+
+/* Brightness goes into the 5 bit global field first */
+static void checkAPA102Brightness() {
+    std::vector<uint8_t> sent = send(PixelType::APA102, 3, 0.5);
+    for (uint8_t i = 0; i < 3; i++)
+        CHECK(sent[4 + i * 4] == (0xE0 | 16), "pixel %u header 0x%02x",
+                i, sent[4 + i * 4]);
+
+    CHECK(pixels.setBrightness(0.5) == 0.5 * 31 / 16, "gamma brightness");
+    CHECK(pixels.setBrightness(1.0) == 1.0, "full brightness");
+    CHECK(pixels.setBrightness(0.01) > 0.3, "1%% leaves a low global level");
+
+    pixels.begin(PixelType::WS2801, PixelColor::RGB, 3);
+    CHECK(pixels.setBrightness(0.5) == 0.5, "only APA102 has a global level");
+}
+
+static void checkWS2801(uint16_t length) {
+    std::vector<uint8_t> sent = send(PixelType::WS2801, length);
+    CHECK(SPI.freq == WS2801_CLOCK, "WS2801 clock %u", SPI.freq);
+
+    std::vector<uint8_t> want;
+    for (uint16_t i = 0; i < length; i++)
+        expectPixel(want, i, 0x00, 0);
+    CHECK(sent == want, "WS2801 %u pixels: %zu bytes, %zu expected",
+            length, sent.size(), want.size());
+}
+
+static void checkLPD8806(uint16_t length) {
+    std::vector<uint8_t> sent = send(PixelType::LPD8806, length);
+    CHECK(SPI.freq == LPD8806_CLOCK, "LPD8806 clock %u", SPI.freq);
+
+    std::vector<uint8_t> want;
+    for (uint16_t i = 0; i < length; i++)
+        expectPixel(want, i, 0x80, 1);
+    want.resize(want.size() + (length + 31) / 32, 0x00);
+    CHECK(sent == want, "LPD8806 %u pixels: %zu bytes, %zu expected",
+            length, sent.size(), want.size());
+
+    // Every color byte has the high bit set, only the latch is zero
+    for (size_t b = 0; b < length * 3u && b < sent.size(); b++)
+        CHECK(sent[b] & 0x80, "LPD8806 %u pixels: byte %zu is 0x%02x",
+                length, b, sent[b]);
+}
+
+static void checkChunks(PixelType type, const char *name) {
+    const uint16_t length = 1360;
+    pixels.begin(type, PixelColor::GRB, length);
+    setFrame(length);
+    pixels.commit();
+    host_spi.clear();
+    pixels.show();
+
+    uint32_t total = length * 3 + (length + 31) / 32;
+    if (type == PixelType::APA102)
+        total = 4 + length * 4 + (length + 15) / 16;
+    uint16_t passes = 1;
+    CHECK(host_spi.size() == SPI_CHUNK && pixels.isBusy(),
+            "%s: %zu bytes in show()", name, host_spi.size());
+    while (pixels.isBusy() && passes < 100) {
+        size_t before = host_spi.size();
+        pixels.service();
+        CHECK(host_spi.size() - before <= SPI_CHUNK, "%s: %zu bytes in a pass",
+                name, host_spi.size() - before);
+        passes++;
+    }
+    CHECK(host_spi.size() == total && passes == (total + SPI_CHUNK - 1) / SPI_CHUNK,
+            "%s: %zu bytes in %u passes", name, host_spi.size(), passes);
+}
+
+/* One write, but the frame time leaves the loop the rest */
+static void checkWS2801Stall() {
+    const uint16_t length = 1360;
+    pixels.begin(PixelType::WS2801, PixelColor::RGB, length);
+    setFrame(length);
+    pixels.commit();
+    host_spi.clear();
+    pixels.show();
+
+    uint32_t write = length * 3 * 8 / (WS2801_CLOCK / 1000000L);
+    CHECK(host_spi.size() == length * 3u && !pixels.isBusy(),
+            "WS2801: %zu bytes in show()", host_spi.size());
+    CHECK(pixels.getMaxFps() <= 1000000UL / (write * WS2801_DUTY),
+            "WS2801: %u fps with a %uus write", pixels.getMaxFps(), write);
+    CHECK(!pixels.canRefresh(), "WS2801: refresh right after the write");
+    host_us += write * WS2801_DUTY + WS2801_TIDLE;
+    CHECK(pixels.canRefresh(), "WS2801: no refresh after the frame time");
+}
+
+int main() {
+    updateGammaTable(2.2, 1.0);
+
+    for (uint16_t length : {1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 341}) {
+        checkAPA102(length);
+        checkWS2801(length);
+        checkLPD8806(length);
+    }
+    checkAPA102Brightness();
+    checkChunks(PixelType::APA102, "APA102");
+    checkChunks(PixelType::LPD8806, "LPD8806");
+    checkWS2801Stall();
+
+    return host_result("test_spi");
+}
@@ -0,0 +1,115 @@
+/*
+* test_waveform.cpp - Decode the WS2811 UART encodings back into the line
+* waveform and check every byte value against the chip timing windows.
+*
+* The UART line is inverted, so a symbol goes out as a high start bit, the
+* inverted data bits LSB first and a low stop bit. Each WS2811 bit starts on
+* a rising edge, its high time says whether it is a 0 or a 1.
+*/
+
+#include "host.h"
+#include "PixelDriver.h"
+
+/* WS2812B windows, the tighter of the common parts, in ns */
+#define T0H_MIN     250
+#define T0H_MAX     550
+#define T1H_MIN     650
+#define T1H_MAX     950
+#define TBIT_MIN    650
+#define TBIT_MAX    1850
+
+PixelDriver pixels;
+
+/* Line levels of a run of inverted UART symbols with dataBits each */
+static std::vector<bool> lineOf(const std::vector<uint8_t> &fifo,
+        uint8_t dataBits) {
+    std::vector<bool> line;
+    for (uint8_t sym : fifo) {
+        line.push_back(true);
+        for (uint8_t b = 0; b < dataBits; b++)
+            line.push_back(!((sym >> b) & 1));
+        line.push_back(false);
+    }
+    return line;
+}
+
+/* WS2811 bits on the line, checking each pulse against the windows */
+static std::vector<bool> decode(const std::vector<bool> &line, double tbit) {
+    std::vector<bool> bits;
+    size_t i = 0;
+    while (i < line.size()) {
+        CHECK(line[i], "bit %zu doesn't start high", bits.size());
+        size_t high = 0, low = 0;
+        while (i < line.size() && line[i]) {
+            high++;
+            i++;
+        }
+        while (i < line.size() && !line[i]) {
+            low++;
+            i++;
+        }
+
+        double th = high * tbit;
+        bool one = th >= T1H_MIN && th <= T1H_MAX;
+        bool zero = th >= T0H_MIN && th <= T0H_MAX;
+        CHECK(one || zero, "bit %zu high for %.1fns", bits.size(), th);
+
+        // The last bit runs into the idle low
+        if (i < line.size()) {
+            double period = (high + low) * tbit;
+            CHECK(period >= TBIT_MIN && period <= TBIT_MAX,
+                    "bit %zu lasts %.1fns", bits.size(), period);
+        }
+        bits.push_back(one);
+    }
+    return bits;
+}
+
+/*
+* Send one frame with subpixel i set to i % 256, so every value goes out,
+* and check the decoded bits against it.
+*/
+static void checkFrame(PixelType type, PixelColor color, uint16_t length,
+        uint8_t dataBits) {
+    pixels.begin(type, color, length);
+    uint16_t channels = length * pixels.getChannels();
+    for (uint16_t i = 0; i < channels; i++)
+        pixels.setValue(i, i);
+    pixels.commit();
+
+    host_fifo[UART1].clear();
+    pixels.show();
+    host_uart(UART1);
+
+    double tbit = 1e9 / Serial1.baud;
+    std::vector<bool> bits = decode(lineOf(host_fifo[UART1], dataBits), tbit);
+
+    CHECK(bits.size() >= channels * 8u && bits.size() < channels * 8u + 3,
+            "%zu bits for %u subpixels", bits.size(), channels);
+    for (size_t b = channels * 8u; b < bits.size(); b++)
+        CHECK(!bits[b], "padding bit %zu is set", b);
+
+    for (uint16_t i = 0; i < channels && (i + 1) * 8u <= bits.size(); i++) {
+        uint8_t val = 0;
+        for (uint8_t b = 0; b < 8; b++)
+            val = (val << 1) | bits[i * 8 + b];
+        CHECK(val == (i & 0xFF), "subpixel %u decoded as %u", i, val);
+    }
+}
+
+int main() {
+    // Pass values straight through, this is about the encoding
+    for (uint8_t ch = 0; ch < GAMMA_CHANNELS; ch++)
+        for (uint16_t v = 0; v < 256; v++)
+            GAMMA_TABLE[ch][v] = v;
+
+    checkFrame(PixelType::WS2811, PixelColor::RGB, 86, 6);
+    checkFrame(PixelType::WS2811_7N1, PixelColor::RGB, 86, 7);
+
+    // 4 and 32 bit frames leave 1 and 2 bits of padding in the last symbol
+    checkFrame(PixelType::WS2811_7N1, PixelColor::RGB, 2, 7);
+    checkFrame(PixelType::WS2811_7N1, PixelColor::RGBW, 1, 7);
+    checkFrame(PixelType::WS2811_7N1, PixelColor::RGBW, 65, 7);
+
+    return host_result("test_waveform");
+}
@@ -0,0 +1,54 @@
+/*
+* test_ws2811.cpp - The pre-encoded WS2811 frame the ISR copies out has to
+* be the byte stream the old ISR encoded on the fly, grouped and zigzagged.
+*/
+
+#include "host.h"
+#include "baseline.h"
+
+#define PIXELS  1360
+
+PixelDriver pixels;
+uint8_t pixdata[PIXELS * 3];
+uint8_t asyncdata[PIXELS * 3];
+
+static void checkLayout(PixelColor color, uint16_t group, uint16_t zigzag) {
+    pixels.begin(PixelType::WS2811, color, PIXELS);
+    pixels.setGroup(group, zigzag);
+    pixels.setValues(0, pixdata, sizeof(pixdata));
+
+    pixels.commit();
+    host_fifo[UART1].clear();
+    pixels.show();
+    host_uart(UART1);
+    std::vector<uint8_t> sent = host_fifo[UART1];
+
+    host_fifo[UART1].clear();
+    baseline::showWS2811(pixdata, asyncdata, sizeof(pixdata), group, zigzag,
+            color, GAMMA_TABLE[0]);
+
+    CHECK(sent == host_fifo[UART1],
+            "color %d group %u zigzag %u: %zu bytes sent, %zu expected",
+            static_cast<int>(color), group, zigzag, sent.size(),
+            host_fifo[UART1].size());
+}
+
+int main() {
+    // The old single table, every channel gets the same curve
+    updateGammaTable(2.2, 1.0);
+
+    srand(1);
+    for (uint16_t i = 0; i < sizeof(pixdata); i++)
+        pixdata[i] = rand();
+
+    for (PixelColor color : {PixelColor::RGB, PixelColor::GRB,
+            PixelColor::BGR}) {
+        checkLayout(color, 1, 0);
+        checkLayout(color, 3, 0);
+        checkLayout(color, 1, 17);
+        checkLayout(color, 4, 10);
+        checkLayout(color, 2, 7);
+    }
+
+    return host_result("test_ws2811");
+}
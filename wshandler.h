@@ -32,8 +32,12 @@ extern EffectEngine effects;    // EffectEngine for test modes
 
 extern ESPAsyncE131 e131;       // ESPAsyncE131 with X buffers
 extern ESPAsyncDDP  ddp;        // ESPAsyncDDP with X buffers
+extern PacketRing   packetRing; // Packets queued for loop()
+extern FrameAssembler ddpFrame; // DDP frame in progress
+extern FrameAssembler zcppFrame;    // ZCPP frame in progress
 extern config_t     config;     // Current configuration
 extern uint32_t     *seqError;  // Sequence error tracking for each universe
+extern uint32_t     seqStale;   // E1.31 packets dropped as out of order
 extern uint16_t     uniLast;    // Last Universe to listen for
 extern bool         reboot;     // Reboot flag
 
@@ -97,6 +101,7 @@ void procX(uint8_t *data, AsyncWebSocketClient *client) {
             e131J["num_packets"] = (String)e131.stats.num_packets;
             e131J["seq_errors"] = (String)seqErrors;
             e131J["packet_errors"] = (String)e131.stats.packet_errors;
+            e131J["stale"] = (String)seqStale;
             e131J["last_clientIP"] = e131.stats.last_clientIP.toString();
 
             JsonObject ddpJ = json.createNestedObject("ddp");
@@ -106,6 +111,26 @@ void procX(uint8_t *data, AsyncWebSocketClient *client) {
             ddpJ["max_channel"] = (String)ddp.stats.ddpMaxChannel;
             ddpJ["min_channel"] = (String)ddp.stats.ddpMinChannel;
 
+            // Output statistics
+            JsonObject outputJ = json.createNestedObject("output");
+            outputJ["overflows"] = (String)packetRing.stats.overflows;
+            outputJ["torn"] = (String)(ddpFrame.stats.torn + zcppFrame.stats.torn);
+            outputJ["late_frames"] = (String)(ddpFrame.stats.late + zcppFrame.stats.late);
+#if defined(ESPS_MODE_PIXEL)
+            outputJ["presented"] = (String)pixels.stats.presented;
+            outputJ["coalesced"] = (String)pixels.stats.coalesced;
+            outputJ["late"] = (String)pixels.stats.late;
+            outputJ["max_fps"] = (String)pixels.getMaxFps();
+            outputJ["current"] = (String)pixels.stats.current;
+            outputJ["peak"] = (String)pixels.stats.peak;
+            outputJ["limit"] = (String)(pixels.getPowerScale() * 100 / 256);
+#elif defined(ESPS_MODE_SERIAL)
+            outputJ["presented"] = (String)serial.stats.presented;
+            outputJ["coalesced"] = (String)serial.stats.coalesced;
+            outputJ["late"] = (String)serial.stats.late;
+            outputJ["max_fps"] = (String)serial.getMaxFps();
+#endif
+
             String response;
             serializeJson(json, response);
             client->text("XJ" + response);
@@ -127,7 +152,12 @@ void procE(uint8_t *data, AsyncWebSocketClient *client) {
             // Pixel Types
             JsonObject p_type = json.createNestedObject("p_type");
             p_type["WS2811 800kHz"] = static_cast<uint8_t>(PixelType::WS2811);
+            p_type["WS2811 800kHz (I2S DMA)"] = static_cast<uint8_t>(PixelType::WS2811_I2S);
+            p_type["WS2811 800kHz (3 bit UART)"] = static_cast<uint8_t>(PixelType::WS2811_7N1);
             p_type["GE Color Effects"] = static_cast<uint8_t>(PixelType::GECE);
+            p_type["APA102 (SPI)"] = static_cast<uint8_t>(PixelType::APA102);
+            p_type["WS2801 (SPI)"] = static_cast<uint8_t>(PixelType::WS2801);
+            p_type["LPD8806 (SPI)"] = static_cast<uint8_t>(PixelType::LPD8806);
 
             // Pixel Colors
             JsonObject p_color = json.createNestedObject("p_color");
@@ -137,6 +167,15 @@ void procE(uint8_t *data, AsyncWebSocketClient *client) {
             p_color["RBG"] = static_cast<uint8_t>(PixelColor::RBG);
             p_color["GBR"] = static_cast<uint8_t>(PixelColor::GBR);
             p_color["BGR"] = static_cast<uint8_t>(PixelColor::BGR);
+            p_color["RGBW"] = static_cast<uint8_t>(PixelColor::RGBW);
+            p_color["GRBW"] = static_cast<uint8_t>(PixelColor::GRBW);
+            p_color["BRGW"] = static_cast<uint8_t>(PixelColor::BRGW);
+            p_color["RBGW"] = static_cast<uint8_t>(PixelColor::RBGW);
+            p_color["GBRW"] = static_cast<uint8_t>(PixelColor::GBRW);
+            p_color["BGRW"] = static_cast<uint8_t>(PixelColor::BGRW);
+
+            // Second string is always WS2811, any color order
+            json["p2_color"] = p_color;
 
 #elif defined (ESPS_MODE_SERIAL)
             // Serial Protocols
@@ -234,15 +273,28 @@ void procG(uint8_t *data, AsyncWebSocketClient *client) {
             break;
         }
 #if defined(ESPS_MODE_PIXEL)
+        /*
+        * One channel's table per request, G4 for red and G41 - G43 for
+        * green, blue and white. Written out by hand, about 1KB of text,
+        * rather than a ~4KB JsonDocument per channel.
+        */
         case '4': {
-            DynamicJsonDocument json(1024);
-            JsonArray gamma = json.createNestedArray("gamma");
-            for (int i=0; i<256; i++) {
-                gamma.add(GAMMA_TABLE[i]);
-            }
+            uint8_t ch = 0;
+            if (data[2] > '0' && data[2] < '0' + GAMMA_CHANNELS)
+                ch = data[2] - '0';
+
             String response;
-            serializeJson(json, response);
-            client->text("G4" + response);
+            response.reserve(32 + 256 * 4);
+            response = F("G4{\"channel\":");
+            response += ch;
+            response += F(",\"gamma\":[");
+            for (int i = 0; i < 256; i++) {
+                if (i)
+                    response += ',';
+                response += GAMMA_TABLE[ch][i];
+            }
+            response += F("]}");
+            client->text(response);
             break;
         }
 #endif
@@ -251,7 +303,7 @@ void procG(uint8_t *data, AsyncWebSocketClient *client) {
 
 void procS(uint8_t *data, AsyncWebSocketClient *client) {
 
-    DynamicJsonDocument json(1024);
+    DynamicJsonDocument json(4096);
     DeserializationError error = deserializeJson(json, reinterpret_cast<char*>(data + 2));
 
     if (error) {